@@ -8,6 +8,7 @@ using namespace std;
 AstNode* makeNode(){
     AstNode* newNode = new AstNode();
     newNode->name = "";
+    newNode->module = "";
     newNode->dataType = DataType::UNKNOWN;
     newNode->exprType = ExprType::UNKNOWN;
     
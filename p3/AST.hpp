@@ -48,6 +48,8 @@ enum class ExprType{
 typedef struct AstNode{
     // identifier name, if exist
     string name;
+    // module (class) of an extern identifier, empty if defined in this file
+    string module;
 
     // data type
     DataType dataType;
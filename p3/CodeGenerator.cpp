@@ -1,23 +1,100 @@
 #include "CodeGenerator.hpp"
 #include "AST.hpp"
 #include "SymbolTable.hpp"
+#include "MethodSplitter.hpp"
 #include <iostream>
 #include <string>
 #include <queue>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <iomanip>
 
 using namespace std;
 
+extern int linenum; // current line of the lexer, used to locate profile sites
+extern SymbolTable* sbt; // current scope, cse temporaries are allocated above its locals
+
+// whether the expression reads or writes local slot
+static bool readsLocal(AstNode* node, int slot){
+    ExprType type = node->exprType;
+    if(type == ExprType::EXPR_ID || type == ExprType::EXPR_INC_PREFIX || type == ExprType::EXPR_DEC_PREFIX
+       || type == ExprType::EXPR_INC_POSTFIX || type == ExprType::EXPR_DEC_POSTFIX){
+        return !node->isGlobal && !node->isConst && node->number == slot;
+    }
+    if(type == ExprType::EXPR_LITERAL) return false;
+    for(AstNode* child : node->children){
+        if(readsLocal(child, slot)) return true;
+    }
+    return false;
+}
+
+// slot of a local load, store or iinc, -1 for other instructions
+static int localSlot(const string& line){
+    if(line.rfind("iload ", 0) == 0 || line.rfind("istore ", 0) == 0 || line.rfind("iinc ", 0) == 0
+       || line.rfind("aload ", 0) == 0 || line.rfind("astore ", 0) == 0){
+        return atoi(line.c_str() + line.find(' ') + 1);
+    }
+    return -1;
+}
+
+// remove the reduction markers of generateAssignment
+static string stripMarkers(string block){
+    string result = "";
+    stringstream ss(block);
+    string line;
+    while(getline(ss, line)){
+        if(line.rfind("/*reduce ", 0) != 0) result += line + "\n";
+    }
+    return result;
+}
+
+
 CodeGenerator::CodeGenerator(){
     this->className = "unknown";
     this->jasmStk.clear();
     this->labelCounter = 0;
+    this->profileGenerate = false;
+    this->profileUse = false;
+    this->cse = false;
+    this->cseDepth = 0;
+    this->cseNextSlot = 0;
+    this->promote = false;
+    this->parallel = true;
+    this->parallelCounter = 0;
+    this->outlined = "";
+    this->methodSizeLimit = 8000;
+    this->splitRetFields = 0;
+    this->splitExitFields = false;
+    this->coalescePrints = false;
+    this->outputWriter = false;
+    this->readHelpers = true;
+    this->naiveRead = false;
+    this->usesRead = false;
 }
 
 CodeGenerator::CodeGenerator(string className){
     this->className = className;
     this->jasmStk.clear();
     this->labelCounter = 0;
+    this->profileGenerate = false;
+    this->profileUse = false;
+    this->cse = false;
+    this->cseDepth = 0;
+    this->cseNextSlot = 0;
+    this->promote = false;
+    this->parallel = true;
+    this->parallelCounter = 0;
+    this->outlined = "";
+    this->methodSizeLimit = 8000;
+    this->splitRetFields = 0;
+    this->splitExitFields = false;
+    this->coalescePrints = false;
+    this->outputWriter = false;
+    this->readHelpers = true;
+    this->naiveRead = false;
+    this->usesRead = false;
 }
 
 string CodeGenerator::dump(){
@@ -27,6 +104,16 @@ string CodeGenerator::dump(){
     return this->jasmStk.back();
 }
 
+string CodeGenerator::getJasm(){
+    return this->jasmStk.back();
+}
+
+// class.name of a global or function, extern identifiers belong to their module's class
+string CodeGenerator::qualifiedName(AstNode* node){
+    string owner = node->module.empty() ? this->className : node->module;
+    return owner + "." + node->name;
+}
+
 string CodeGenerator::getNewLabel(){
     if(this->labelCounter == 16){
         this->jasmStk.back() += "/*hahahaha*/\n";
@@ -36,11 +123,39 @@ string CodeGenerator::getNewLabel(){
 
 
 void CodeGenerator::generateProgram(){
+    string reader = (this->usesRead && this->readHelpers) ? this->readMethods() : "";
     string jasm = "";
     while(!this->jasmStk.empty()){
         jasm = this->jasmStk.back() + jasm;
         this->jasmStk.pop_back();
     }
+    jasm += this->outlined;
+    if(reader != "") jasm = this->readFields() + jasm + reader;
+    if(this->outputWriter) jasm = "field static java.io.PrintWriter __out\n" + jasm;
+    if(this->splitExitFields) jasm = "field static int __split_exit\nfield static int __split_value\n" + jasm;
+    for(int i=this->splitRetFields-1; i>=0; i--) jasm = "field static int __split_ret_" + to_string(i) + "\n" + jasm;
+    if(this->profileGenerate){
+        string fields = "";
+        for(int i=0; i<(int)this->profileSites.size(); i++){
+            fields += "field static int __prof_" + to_string(i) + "\n";
+        }
+        jasm = fields + jasm + this->profileDumpMethod();
+    }
+    // <clinit>: the PrintWriter of the class, and the shutdown hooks that flush it and write the profile
+    string init = "";
+    if(this->outputWriter){
+        string out = "java.io.PrintWriter " + this->className + ".__out\n";
+        init += "new java.io.PrintWriter\ndup\nnew java.io.BufferedOutputStream\ndup\nnew java.io.FileOutputStream\ndup\n";
+        init += "getstatic java.io.FileDescriptor java.io.FileDescriptor.out\n";
+        init += "invokespecial void java.io.FileOutputStream.<init>(java.io.FileDescriptor)\nldc 65536\n";
+        init += "invokespecial void java.io.BufferedOutputStream.<init>(java.io.OutputStream, int)\n";
+        init += "invokespecial void java.io.PrintWriter.<init>(java.io.OutputStream)\nputstatic " + out;
+        init += this->shutdownHook("__out_flush");
+        jasm += "method public static void __out_flush()\nmax_stack 1\nmax_locals 0\n{\n";
+        jasm += "getstatic " + out + "invokevirtual void java.io.PrintWriter.flush()\nreturn\n}\n";
+    }
+    if(this->profileGenerate) init += this->shutdownHook("__prof_dump");
+    if(init != "") jasm += "method public static void <clinit>()\nmax_stack 1000\nmax_locals 1000\n{\n" + init + "return\n}\n";
     jasm = "class " + this->className + "\n{\n" + jasm + "}";
     this->jasmStk.push_back(jasm); // only one element in jasm stack
 }
@@ -72,9 +187,32 @@ void CodeGenerator::generateFuncDecl(AstNode* node){
     if(node->name == "main") wrapper += "java.lang.String[]";
     wrapper += ")\n";
     wrapper += "max_stack 1000\nmax_locals 1000\n{\n";
-    this->jasmStk.back() = wrapper + this->jasmStk.back();
-    if(node->dataType == DataType::VOID_T) this->jasmStk.back() += "return\n";
-    this->jasmStk.back() += "}\n";
+
+    string body = this->counterInc(this->newCounter("function", node->name)) + this->jasmStk.back();
+    if(node->dataType == DataType::VOID_T) body += "return\n";
+    body = stripMarkers(body);
+    this->globalSummary[node->name] = this->touchedGlobals(body, node->name);
+    if(this->isPure(body, node->name)) this->pureFunctions.insert(node->name);
+    if(this->coalescePrints) body = this->coalesce(body);
+    if(this->profileUse) body = this->assignSlots(body, node->paramList.size());
+    this->slotWeight.clear();
+
+    MethodSplitter splitter(this->className, this->methodSizeLimit);
+    string helpers = splitter.split(node->name, body);
+    if(splitter.numHelpers > 0){
+        this->outlined += helpers;
+        this->splitRetFields = max(this->splitRetFields, splitter.numRetFields);
+        this->splitExitFields = this->splitExitFields || splitter.exitFields;
+        if(splitter.numRetFields > 0 || splitter.exitFields) this->pureFunctions.erase(node->name); // the helpers return through fields
+        cerr << "Warning: function " << node->name << " is " << splitter.sizeBefore << " bytes, split into "
+             << node->name << " (" << splitter.sizeAfter << " bytes) and " << splitter.numHelpers
+             << " helpers (largest " << splitter.largestHelper << " bytes)" << endl;
+    }
+    if(this->methodSizeLimit > 0 && splitter.sizeAfter > this->methodSizeLimit){
+        cerr << "Warning: function " << node->name << " is still " << splitter.sizeAfter << " bytes, over the limit of "
+             << this->methodSizeLimit << " bytes" << endl;
+    }
+    this->jasmStk.back() = wrapper + body + "}\n";
 }
 
 void CodeGenerator::insertEmpty(){
@@ -89,14 +227,135 @@ void CodeGenerator::combineTopTwo(){
     this->jasmStk.back() += tmp;
 }
 
+void CodeGenerator::setCse(bool enable){
+    this->cse = enable;
+}
+
+/*
+ * exprDFS with cse: value numbering inside one expression tree
+ * (statements only exist as jasm text, so the tree is the basic block we can see)
+ * a pure subtree occurring more than once is stored to a temporary at its first evaluation
+ * and reloaded afterwards (if it saves instructions), ++/-- of a variable and function calls invalidate the values they may change
+ */
 string CodeGenerator::exprDFS(AstNode* node){
+    if(!this->cse) return this->exprCode(node);
+    if(this->cseDepth == 0){
+        this->cseCount.clear();
+        this->cseSlot.clear();
+        this->cseVars.clear();
+        this->cseCountTree(node);
+        this->cseNextSlot = sbt->counter;
+    }
+
+    vector<string> vars;
+    string key = this->cseKey(node, vars);
+    bool candidate = this->cseProfitable(node, key);
+    if(candidate && this->cseSlot.find(key) != this->cseSlot.end()){
+        return "iload " + to_string(this->cseSlot[key]) + "\n";
+    }
+
+    this->cseDepth++;
+    string jasm = this->exprCode(node);
+    this->cseDepth--;
+
+    if(candidate){
+        int slot = this->cseNextSlot++;
+        this->cseSlot[key] = slot;
+        this->cseVars[key] = vars;
+        jasm += "dup\nistore " + to_string(slot) + "\n";
+    }
+    // side effects, after the code of node
+    ExprType type = node->exprType;
+    if(type == ExprType::EXPR_INC_PREFIX || type == ExprType::EXPR_DEC_PREFIX
+       || type == ExprType::EXPR_INC_POSTFIX || type == ExprType::EXPR_DEC_POSTFIX){
+        this->cseKill(node->isGlobal ? "g:" + this->qualifiedName(node) : "l:" + to_string(node->number));
+    }
+    if(type == ExprType::EXPR_FUNCCALL) this->cseKill("g:"); // a call may write any global
+    return jasm;
+}
+
+// structural key of a pure subtree and the variables it reads, "" if not pure
+string CodeGenerator::cseKey(AstNode* node, vector<string>& vars){
+    if(node->dataType == DataType::STRING_T) return "";
+    ExprType type = node->exprType;
+    if(type == ExprType::EXPR_LITERAL) return "c:" + to_string(node->iVal);
+    if(type == ExprType::EXPR_ID){
+        if(node->isConst) return "c:" + to_string(node->iVal);
+        string var = node->isGlobal ? "g:" + this->qualifiedName(node) : "l:" + to_string(node->number);
+        vars.push_back(var);
+        return var;
+    }
+    if(type == ExprType::EXPR_NOT || type == ExprType::EXPR_NEG){
+        string child = this->cseKey(node->children[0], vars);
+        if(child == "") return "";
+        return "(" + getTypeStr(type) + " " + child + ")";
+    }
+    if(type >= ExprType::EXPR_LAND && type <= ExprType::EXPR_MOD){
+        string left = this->cseKey(node->children[0], vars);
+        if(left == "") return "";
+        string right = this->cseKey(node->children[1], vars);
+        if(right == "") return "";
+        return "(" + getTypeStr(type) + " " + left + " " + right + ")";
+    }
+    return ""; // ++, --, function call
+}
+
+// executed instructions of a pure subtree, a global load counts as 3 (getstatic is 3 bytes and a field access)
+int CodeGenerator::cseSize(AstNode* node){
+    ExprType type = node->exprType;
+    if(type == ExprType::EXPR_ID) return (node->isGlobal && !node->isConst) ? 3 : 1;
+    if(type == ExprType::EXPR_LITERAL) return 1;
+    if(type == ExprType::EXPR_NEG) return this->cseSize(node->children[0]) + 1;
+    if(type == ExprType::EXPR_NOT) return this->cseSize(node->children[0]) + 2;
+    int size = this->cseSize(node->children[0]) + this->cseSize(node->children[1]);
+    if(type >= ExprType::EXPR_LT && type <= ExprType::EXPR_NEQ) return size + 5; // isub, if, 3 of the materialization
+    return size + 1;
+}
+
+// worth a temporary: every reuse saves size - 1 instructions, dup and istore cost 2
+// locals, constants and literals are never worth it, a global is when loaded often enough
+bool CodeGenerator::cseProfitable(AstNode* node, string key){
+    if(key == "" || node->exprType == ExprType::EXPR_LITERAL) return false;
+    if(node->exprType == ExprType::EXPR_ID && !(node->isGlobal && !node->isConst)) return false;
+    return (this->cseCount[key] - 1) * (this->cseSize(node) - 1) > 2;
+}
+
+// count occurrences in evaluation order, subtrees that will be reloaded as a whole do not count their children
+void CodeGenerator::cseCountTree(AstNode* node){
+    vector<string> vars;
+    string key = this->cseKey(node, vars);
+    if(key != ""){
+        this->cseCount[key]++;
+        if(this->cseProfitable(node, key)) return;
+    }
+    ExprType type = node->exprType;
+    if(type == ExprType::EXPR_ID || type == ExprType::EXPR_LITERAL) return;
+    for(AstNode* child : node->children) this->cseCountTree(child);
+}
+
+// invalidate the values reading var, a prefix such as "g:" matches every global
+void CodeGenerator::cseKill(string var){
+    for(auto it = this->cseVars.begin(); it != this->cseVars.end(); ){
+        bool reads = false;
+        for(string& v : it->second){
+            if(v.rfind(var, 0) == 0 && (v.size() == var.size() || var == "g:")) reads = true;
+        }
+        if(reads){
+            this->cseSlot.erase(it->first);
+            it = this->cseVars.erase(it);
+        }
+        else it++;
+    }
+}
+
+string CodeGenerator::exprCode(AstNode* node){
     if(node->exprType == ExprType::EXPR_ID){
         if(node->isConst){
             if(node->dataType == DataType::INT_T) return "sipush " + to_string(node->iVal) + "\n";
             if(node->dataType == DataType::BOOL_T) return "iconst_" + to_string(node->iVal) + "\n";
             if(node->dataType == DataType::STRING_T) return "ldc \"" + node->sVal + "\"\n";
         }
-        if(node->isGlobal) return "getstatic int " + this->className + "." + node->name + "\n";
+        if(node->isGlobal) return "getstatic int " + this->qualifiedName(node) + "\n";
         else return "iload " + to_string(node->number) + "\n";
     }
     if(node->exprType == ExprType::EXPR_LITERAL){
@@ -108,10 +367,10 @@ string CodeGenerator::exprDFS(AstNode* node){
     if(node->exprType == ExprType::EXPR_NOT)  return exprDFS(node->children[0]) + "iconst_1\nixor\n";
     if(node->exprType == ExprType::EXPR_INC_PREFIX){
         if(node->isGlobal){
-            return "getstatic int " + this->className + "." + node->name + "\n"
+            return "getstatic int " + this->qualifiedName(node) + "\n"
                  + "iconst_1\niadd\n"
-                 + "putstatic int " + this->className + "." + node->name + "\n"
-                 + "getstatic int " + this->className + "." + node->name + "\n";
+                 + "putstatic int " + this->qualifiedName(node) + "\n"
+                 + "getstatic int " + this->qualifiedName(node) + "\n";
         }
         else{
             return "iinc " + to_string(node->number) + " 1\n" + "iload " + to_string(node->number) + "\n";   
@@ -119,10 +378,10 @@ string CodeGenerator::exprDFS(AstNode* node){
     }
     if(node->exprType == ExprType::EXPR_DEC_PREFIX){
         if(node->isGlobal){
-            return "getstatic int " + this->className + "." + node->name + "\n"
+            return "getstatic int " + this->qualifiedName(node) + "\n"
                  + "iconst_1\nisub\n"
-                 + "putstatic int " + this->className + "." + node->name + "\n"
-                 + "getstatic int " + this->className + "." + node->name + "\n";
+                 + "putstatic int " + this->qualifiedName(node) + "\n"
+                 + "getstatic int " + this->qualifiedName(node) + "\n";
         }
         else{
             return "iinc " + to_string(node->number) + " -1\n" + "iload " + to_string(node->number) + "\n";   
@@ -130,10 +389,10 @@ string CodeGenerator::exprDFS(AstNode* node){
     }
     if(node->exprType == ExprType::EXPR_INC_POSTFIX){
         if(node->isGlobal){
-            return "getstatic int " + this->className + "." + node->name + "\n"
-                 + "getstatic int " + this->className + "." + node->name + "\n"
+            return "getstatic int " + this->qualifiedName(node) + "\n"
+                 + "getstatic int " + this->qualifiedName(node) + "\n"
                  + "iconst_1\niadd\n"
-                 + "putstatic int " + this->className + "." + node->name + "\n";
+                 + "putstatic int " + this->qualifiedName(node) + "\n";
         }
         else{
             return "iload " + to_string(node->number) + "\n" + "iinc " + to_string(node->number) + " 1\n";   
@@ -141,10 +400,10 @@ string CodeGenerator::exprDFS(AstNode* node){
     }
     if(node->exprType == ExprType::EXPR_DEC_POSTFIX){
         if(node->isGlobal){
-            return "getstatic int " + this->className + "." + node->name + "\n"
-                 + "getstatic int " + this->className + "." + node->name + "\n"
+            return "getstatic int " + this->qualifiedName(node) + "\n"
+                 + "getstatic int " + this->qualifiedName(node) + "\n"
                  + "iconst_1\nisub\n"
-                 + "putstatic int " + this->className + "." + node->name + "\n";
+                 + "putstatic int " + this->qualifiedName(node) + "\n";
         }
         else{
             return "iload " + to_string(node->number) + "\n" + "iinc " + to_string(node->number) + " -1\n";   
@@ -165,11 +424,13 @@ string CodeGenerator::exprDFS(AstNode* node){
             types.pop_back();
         }
         types += ")\n";
-        return preprocess + "invokestatic " + getTypeStr(node->dataType) + " " + this->className + "." + node->name + types;
+        return preprocess + "invokestatic " + getTypeStr(node->dataType) + " " + this->qualifiedName(node) + types;
     }
 
         
-    string prefix = exprDFS(node->children[0]) + exprDFS(node->children[1]);
+    // generate in evaluation order, cse relies on it
+    string left = exprDFS(node->children[0]);
+    string prefix = left + exprDFS(node->children[1]);
     if(node->exprType == ExprType::EXPR_LAND) return prefix + "iand\n";
     if(node->exprType == ExprType::EXPR_LOR)  return prefix + "ior\n";
     if(node->exprType == ExprType::EXPR_ADD)  return prefix + "iadd\n";
@@ -204,37 +465,68 @@ void CodeGenerator::generateAssignment(AstNode* node){
     this->generateExpr(node->children[1]);
     string exprBlock = this->jasmStk.back(); this->jasmStk.pop_back();
     string tmp = exprBlock;
-    if(node->children[0]->isGlobal) tmp += "putstatic int " + this->className + "." + node->children[0]->name + "\n";
-    else tmp += "istore " + to_string(node->children[0]->number) + "\n";
+    AstNode* lhs = node->children[0];
+    AstNode* rhs = node->children[1];
+    if(lhs->isGlobal) tmp += "putstatic int " + this->qualifiedName(lhs) + "\n";
+    else{
+        // x = x + e, x = e + x: mark the reduction for parallel foreach, removed when the function is complete
+        if(rhs->exprType == ExprType::EXPR_ADD){
+            for(int i=0; i<2; i++){
+                AstNode* self = rhs->children[i];
+                AstNode* other = rhs->children[1 - i];
+                if(self->exprType == ExprType::EXPR_ID && !self->isGlobal && !self->isConst && self->number == lhs->number
+                   && !readsLocal(other, lhs->number)){
+                    tmp += "/*reduce " + to_string(lhs->number) + "*/\n";
+                    break;
+                }
+            }
+        }
+        tmp += "istore " + to_string(lhs->number) + "\n";
+    }
     this->jasmStk.push_back(tmp);
 }
 
 void CodeGenerator::generatePrint(AstNode* node){
     this->generateExpr(node);
     string exprBlock = this->jasmStk.back(); this->jasmStk.pop_back();
-    string tmp = "getstatic java.io.PrintStream java.lang.System.out\n" + exprBlock;
-    if(node->dataType == DataType::STRING_T) tmp += "invokevirtual void java.io.PrintStream.print(java.lang.String)\n";
-    if(node->dataType == DataType::INT_T)    tmp += "invokevirtual void java.io.PrintStream.print(int)\n";
-    if(node->dataType == DataType::BOOL_T)   tmp += "invokevirtual void java.io.PrintStream.print(boolean)\n";
+    string tmp = this->printReceiver() + exprBlock;
+    if(node->dataType == DataType::STRING_T) tmp += this->printMethod("print") + "(java.lang.String)\n";
+    if(node->dataType == DataType::INT_T)    tmp += this->printMethod("print") + "(int)\n";
+    if(node->dataType == DataType::BOOL_T)   tmp += this->printMethod("print") + "(boolean)\n";
     this->jasmStk.push_back(tmp);
 }
 
 void CodeGenerator::generatePrintln(AstNode* node){
     this->generateExpr(node);
     string exprBlock = this->jasmStk.back(); this->jasmStk.pop_back();
-    string tmp = "getstatic java.io.PrintStream java.lang.System.out\n" + exprBlock;
-    if(node->dataType == DataType::STRING_T) tmp += "invokevirtual void java.io.PrintStream.println(java.lang.String)\n";
-    if(node->dataType == DataType::INT_T)    tmp += "invokevirtual void java.io.PrintStream.println(int)\n";
-    if(node->dataType == DataType::BOOL_T)   tmp += "invokevirtual void java.io.PrintStream.println(boolean)\n";
+    string tmp = this->printReceiver() + exprBlock;
+    if(node->dataType == DataType::STRING_T) tmp += this->printMethod("println") + "(java.lang.String)\n";
+    if(node->dataType == DataType::INT_T)    tmp += this->printMethod("println") + "(int)\n";
+    if(node->dataType == DataType::BOOL_T)   tmp += this->printMethod("println") + "(boolean)\n";
     this->jasmStk.push_back(tmp);
 }
 
 
+void CodeGenerator::generateRead(AstNode* node){
+    string type = getTypeStr(node->dataType);
+    string tmp = "invokestatic " + type + " " + this->className + ".__read_" + type + "()\n";
+    if(node->isGlobal) tmp += "putstatic int " + this->qualifiedName(node) + "\n";
+    else tmp += "istore " + to_string(node->number) + "\n";
+    if(!this->usesRead){
+        // the readers only touch their own fields
+        this->globalSummary["__read_int"] = {};
+        this->globalSummary["__read_bool"] = {};
+        this->usesRead = true;
+    }
+    this->jasmStk.push_back(tmp);
+}
+
 
 void CodeGenerator::generateIf(AstNode* node){
     this->generateExpr(node);
     string exprBlock = this->jasmStk.back(); this->jasmStk.pop_back();
     string ifBlock = this->jasmStk.back(); this->jasmStk.pop_back();
+    ifBlock = this->counterInc(this->newCounter("then", "-")) + ifBlock;
     string Lfalse = this->getNewLabel();
     string tmp = exprBlock + "ifeq " + Lfalse + "\n" + ifBlock + Lfalse + ": \nnop\n";
     this->jasmStk.push_back(tmp);
@@ -246,8 +538,18 @@ void CodeGenerator::generateIfElse(AstNode* node){
     string exprBlock = this->jasmStk.back(); this->jasmStk.pop_back();
     string elseBlock = this->jasmStk.back(); this->jasmStk.pop_back();
     string ifBlock = this->jasmStk.back(); this->jasmStk.pop_back();
+    int thenCounter = this->newCounter("then", "-"), elseCounter = this->newCounter("else", "-");
+    ifBlock = this->counterInc(thenCounter) + ifBlock;
+    elseBlock = this->counterInc(elseCounter) + elseBlock;
     string Lfalse = this->getNewLabel(), Lexit = this->getNewLabel();
-    string tmp = exprBlock + "ifeq " + Lfalse + "\n" + ifBlock + "goto " + Lexit + "\n" + Lfalse + ": \nnop\n" + elseBlock + Lexit + ": \nnop\n";
+    string tmp;
+    if(this->profileUse && this->profileCount(elseCounter) > this->profileCount(thenCounter)){
+        // else arm is hotter, let it fall through
+        tmp = exprBlock + "ifne " + Lfalse + "\n" + elseBlock + "goto " + Lexit + "\n" + Lfalse + ": \nnop\n" + ifBlock + Lexit + ": \nnop\n";
+    }
+    else{
+        tmp = exprBlock + "ifeq " + Lfalse + "\n" + ifBlock + "goto " + Lexit + "\n" + Lfalse + ": \nnop\n" + elseBlock + Lexit + ": \nnop\n";
+    }
     this->jasmStk.push_back(tmp);
 }
 
@@ -255,9 +557,13 @@ void CodeGenerator::generateWhile(AstNode* node){
     this->generateExpr(node);
     string exprBlock = this->jasmStk.back(); this->jasmStk.pop_back();
     string stmtBlock = this->jasmStk.back(); this->jasmStk.pop_back();
+    int counter = this->newCounter("loop", "-");
+    stmtBlock += this->counterInc(counter); // back-edge
     string Lbegin = this->getNewLabel(), Lexit = this->getNewLabel();
 
     string tmp = Lbegin + ": \n" + exprBlock + "ifeq " + Lexit + "\n" +  stmtBlock + "goto " + Lbegin + "\n" + Lexit + ": \nnop\n";
+    tmp = this->promoteGlobals(tmp);
+    this->weighSlots(tmp, counter);
     this->jasmStk.push_back(tmp);
 }
 
@@ -267,10 +573,14 @@ void CodeGenerator::generateFor(AstNode* node){
     string stmtBlock     = this->jasmStk.back(); this->jasmStk.pop_back();
     string postStmtBlock = this->jasmStk.back(); this->jasmStk.pop_back();
     string preStmtBlock  = this->jasmStk.back(); this->jasmStk.pop_back();
+    int counter = this->newCounter("loop", "-");
+    postStmtBlock += this->counterInc(counter); // back-edge
 
     string Lbegin = this->getNewLabel(), Lexit = this->getNewLabel();
 
     string tmp = preStmtBlock + Lbegin + ": \nnop\n" + exprBlock + "ifeq " + Lexit + "\n" +  stmtBlock + postStmtBlock + "goto " + Lbegin + "\n" + Lexit + ": \nnop\n";
+    tmp = this->promoteGlobals(tmp);
+    this->weighSlots(tmp, counter);
     this->jasmStk.push_back(tmp);
 }
 
@@ -281,6 +591,8 @@ void CodeGenerator::generateForeach(AstNode* node){
     AstNode* b  = node->children[2];
 
     string stmtBlock = this->jasmStk.back(); this->jasmStk.pop_back();
+    int counter = this->newCounter("loop", "-");
+    stmtBlock += this->counterInc(counter); // back-edge
     
     AstNode* nodePair = makeNode();
     nodePair->children = {a, b};
@@ -299,7 +611,7 @@ void CodeGenerator::generateForeach(AstNode* node){
     string decPostBlock = this->exprDFS(id) + "pop\n";;
 
     string preBlock = this->exprDFS(a);
-    if(id->isGlobal) preBlock += "putstatic int " + this->className + "." + id->name + "\n";
+    if(id->isGlobal) preBlock += "putstatic int " + this->qualifiedName(id) + "\n";
     else preBlock += "istore " + to_string(id->number) + "\n";
     
     string Lbegin = this->getNewLabel(), LdecExpr = this->getNewLabel(), LexprExit = this->getNewLabel();
@@ -315,10 +627,205 @@ void CodeGenerator::generateForeach(AstNode* node){
     tmp += Lexit + ": \nnop\n";
     tmp += "pop\n";
 
+    tmp = this->promoteGlobals(tmp);
+    this->weighSlots(tmp, counter);
     this->jasmStk.push_back(tmp);
 }
 
 
+/*
+ * parallel foreach
+ * the body is outlined into __par_<k>(AtomicIntegerArray), the array holds
+ *   [0] next chunk, [1] a, [2] b, [3] number of chunks, [4..] reductions, then captured locals
+ * the loop builds a Runnable over the bound method handle, runs one ForkJoinTask per chunk
+ * with ForkJoinTask.invokeAll on the common pool, and adds the partial sums of the reductions
+ * the body may read locals and globals, but only write its own locals and reductions (x = x + e)
+ */
+void CodeGenerator::setParallel(bool enable){
+    this->parallel = enable;
+}
+
+string CodeGenerator::generateParallelForeach(AstNode* node){
+    AstNode* id = node->children[0];
+    AstNode* a  = node->children[1];
+    AstNode* b  = node->children[2];
+    int outer = sbt->counter; // slots below belong to the enclosing scopes
+
+    set<int> bounds = {id->number};
+    for(AstNode* bound : {a, b}){
+        if(bound->exprType == ExprType::EXPR_ID && !bound->isGlobal && !bound->isConst) bounds.insert(bound->number);
+    }
+    vector<int> reductions, captures;
+    string reason = this->parallelHazard(this->jasmStk.back(), outer, id->number, bounds, reductions, captures);
+    if(reason != "") return reason;
+
+    // other targets, and -fprofile-generate whose counters are not atomic
+    if(!this->parallel || this->profileGenerate){
+        this->jasmStk.back() = stripMarkers(this->jasmStk.back());
+        this->generateForeach(node);
+        return "";
+    }
+    string stmtBlock = stripMarkers(this->jasmStk.back()); this->jasmStk.pop_back();
+    this->newCounter("loop", "-"); // keep the counter ids of -fprofile-use in step with the sequential loop
+
+    string array = "java.util.concurrent.atomic.AtomicIntegerArray";
+    string get = "invokevirtual int " + array + ".get(int)\n";
+    string set = "invokevirtual void " + array + ".set(int, int)\n";
+    int firstCapture = 4 + reductions.size();
+    string method = "__par_" + to_string(this->parallelCounter++);
+
+    // outlined chunk: lo..hi of chunk c, the loop variable and the captured locals keep their slots
+    int maxSlot = outer;
+    stringstream ss(stmtBlock);
+    string line;
+    while(getline(ss, line)){
+        if(line.rfind("iload ", 0) == 0 || line.rfind("istore ", 0) == 0 || line.rfind("iinc ", 0) == 0){
+            maxSlot = max(maxSlot, atoi(line.c_str() + line.find(' ') + 1));
+        }
+    }
+    int H = maxSlot + 1, lo = H + 1, hi = H + 2, size = H + 3, end = H + 4;
+    string i = to_string(id->number);
+    auto iload  = [](int slot){ return "iload " + to_string(slot) + "\n"; };
+    auto istore = [](int slot){ return "istore " + to_string(slot) + "\n"; };
+    auto field  = [&](int index){ return "aload " + to_string(H) + "\nsipush " + to_string(index) + "\n"; };
+
+    string chunk = "method public static void " + method + "(" + array + ")\nmax_stack 1000\nmax_locals 1000\n{\n";
+    chunk += "aload 0\nastore " + to_string(H) + "\n";
+    for(int k=0; k<(int)captures.size(); k++) chunk += field(firstCapture + k) + get + istore(captures[k]);
+    for(int r : reductions) chunk += "sipush 0\n" + istore(r);
+    chunk += field(1) + get + istore(lo) + field(2) + get + istore(hi);
+    string Lordered = this->getNewLabel();
+    chunk += iload(lo) + iload(hi) + "isub\nifle " + Lordered + "\n" + iload(lo) + iload(hi) + istore(lo) + istore(hi) + Lordered + ": \nnop\n";
+    chunk += iload(hi) + iload(lo) + "isub\n" + field(3) + get + "iadd\n" + field(3) + get + "idiv\n" + istore(size);
+    chunk += iload(lo) + field(0) + "invokevirtual int " + array + ".getAndIncrement(int)\n" + iload(size) + "imul\niadd\nistore " + i + "\n";
+    chunk += "iload " + i + "\n" + iload(size) + "iadd\nsipush 1\nisub\n" + istore(end);
+    string Lclamped = this->getNewLabel(), Lbegin = this->getNewLabel(), Lexit = this->getNewLabel();
+    chunk += iload(end) + iload(hi) + "isub\nifle " + Lclamped + "\n" + iload(hi) + istore(end) + Lclamped + ": \nnop\n";
+    chunk += Lbegin + ": \nnop\niload " + i + "\n" + iload(end) + "isub\nifgt " + Lexit + "\n";
+    chunk += stmtBlock + "iinc " + i + " 1\ngoto " + Lbegin + "\n" + Lexit + ": \nnop\n";
+    for(int k=0; k<(int)reductions.size(); k++){
+        chunk += field(4 + k) + iload(reductions[k]) + "invokevirtual int " + array + ".addAndGet(int, int)\npop\n";
+    }
+    chunk += "return\n}\n";
+    this->outlined += chunk;
+
+    // driver locals, reserved in the enclosing scope so later declarations and cse temporaries do not reuse them
+    int P = sbt->counter++, R = sbt->counter++, L = sbt->counter++, K = sbt->counter++;
+    auto driverField = [&](int index){ return "aload " + to_string(P) + "\nsipush " + to_string(index) + "\n"; };
+    string tmp = "new " + array + "\ndup\nsipush " + to_string(firstCapture + captures.size()) + "\n";
+    tmp += "invokespecial void " + array + ".<init>(int)\nastore " + to_string(P) + "\n";
+    tmp += driverField(1) + this->exprDFS(a) + set + driverField(2) + this->exprDFS(b) + set;
+    tmp += driverField(3) + "invokestatic int java.util.concurrent.ForkJoinPool.getCommonPoolParallelism()\nsipush 4\nimul\n" + set;
+    for(int k=0; k<(int)captures.size(); k++) tmp += driverField(firstCapture + k) + iload(captures[k]) + set;
+
+    string forName = "invokestatic java.lang.Class java.lang.Class.forName(java.lang.String)\n";
+    tmp += "ldc \"java.lang.Runnable\"\n" + forName;
+    tmp += "invokestatic java.lang.invoke.MethodHandles$Lookup java.lang.invoke.MethodHandles.lookup()\n";
+    tmp += "ldc \"" + this->className + "\"\n" + forName + "ldc \"" + method + "\"\n";
+    tmp += "getstatic java.lang.Class java.lang.Void.TYPE\nldc \"" + array + "\"\n" + forName;
+    tmp += "invokestatic java.lang.invoke.MethodType java.lang.invoke.MethodType.methodType(java.lang.Class, java.lang.Class)\n";
+    tmp += "invokevirtual java.lang.invoke.MethodHandle java.lang.invoke.MethodHandles$Lookup.findStatic(java.lang.Class, java.lang.String, java.lang.invoke.MethodType)\n";
+    tmp += "aload " + to_string(P) + "\ninvokevirtual java.lang.invoke.MethodHandle java.lang.invoke.MethodHandle.bindTo(java.lang.Object)\n";
+    tmp += "invokestatic java.lang.Object java.lang.invoke.MethodHandleProxies.asInterfaceInstance(java.lang.Class, java.lang.invoke.MethodHandle)\n";
+    tmp += "astore " + to_string(R) + "\n";
+
+    string Ltasks = this->getNewLabel(), Ldone = this->getNewLabel();
+    tmp += "new java.util.ArrayList\ndup\ninvokespecial void java.util.ArrayList.<init>()\nastore " + to_string(L) + "\n";
+    tmp += "sipush 0\n" + istore(K) + Ltasks + ": \nnop\n" + iload(K) + driverField(3) + get + "isub\nifge " + Ldone + "\n";
+    tmp += "aload " + to_string(L) + "\naload " + to_string(R) + "\n";
+    tmp += "invokestatic java.util.concurrent.ForkJoinTask java.util.concurrent.ForkJoinTask.adapt(java.lang.Runnable)\n";
+    tmp += "invokevirtual boolean java.util.ArrayList.add(java.lang.Object)\npop\n";
+    tmp += "iinc " + to_string(K) + " 1\ngoto " + Ltasks + "\n" + Ldone + ": \nnop\n";
+    tmp += "aload " + to_string(L) + "\ninvokestatic java.util.Collection java.util.concurrent.ForkJoinTask.invokeAll(java.util.Collection)\npop\n";
+
+    for(int k=0; k<(int)reductions.size(); k++){
+        tmp += iload(reductions[k]) + driverField(4 + k) + get + "iadd\n" + istore(reductions[k]);
+    }
+    // the loop variable ends one past b, as in the sequential loop
+    string Lascending = this->getNewLabel(), Lend = this->getNewLabel();
+    tmp += this->exprDFS(a) + this->exprDFS(b) + "isub\niflt " + Lascending + "\n";
+    tmp += this->exprDFS(b) + "sipush 1\nisub\nistore " + i + "\ngoto " + Lend + "\n";
+    tmp += Lascending + ": \nnop\n" + this->exprDFS(b) + "sipush 1\niadd\nistore " + i + "\n" + Lend + ": \nnop\n";
+    this->jasmStk.push_back(tmp);
+    return "";
+}
+
+// reason the body has a loop-carried dependence or a side effect, "" if the iterations are independent
+string CodeGenerator::parallelHazard(string body, int outer, int id, set<int> bounds, vector<int>& reductions, vector<int>& captures){
+    map<int, int> reads, reduced;
+    string own = "invokestatic ", line, previous = "";
+    stringstream ss(body);
+    while(getline(ss, line)){
+        int slot = (line.find(' ') != string::npos) ? atoi(line.c_str() + line.find(' ') + 1) : -1;
+        if(line.rfind("istore ", 0) == 0 && slot < outer){
+            if(slot == id) return "writes the loop variable " + this->localName(slot);
+            if(previous != "/*reduce " + to_string(slot) + "*/") return "writes " + this->localName(slot) + ", which is declared outside the loop and not a reduction x = x + e";
+            if(bounds.count(slot)) return "reduction variable " + this->localName(slot) + " is a bound of the range";
+            reduced[slot]++;
+        }
+        else if(line.rfind("iinc ", 0) == 0 && slot < outer){
+            if(slot == id) return "writes the loop variable " + this->localName(slot);
+            return "writes " + this->localName(slot) + ", which is declared outside the loop and not a reduction x = x + e";
+        }
+        else if(line.rfind("iload ", 0) == 0 && slot < outer && slot != id) reads[slot]++;
+        else if(line.rfind("putstatic ", 0) == 0 && line.find(".__prof_") == string::npos){
+            return "writes the global " + line.substr(line.rfind('.') + 1);
+        }
+        else if(this->isPrintReceiver(line)) return "prints";
+        else if(line.find("ForkJoinTask") != string::npos) return "nested parallel foreach";
+        else if(line.rfind("invokestatic ", 0) == 0 && line.find(".__prof_") == string::npos){
+            size_t space = line.find(' ', 13), paren = line.find('(');
+            string name = line.substr(space + 1, paren - space - 1);
+            size_t dot = name.rfind('.');
+            if(name.substr(0, dot) != this->className || !this->pureFunctions.count(name.substr(dot + 1))){
+                return "calls " + name + ", which may write globals, print or read";
+            }
+        }
+        else if(line == "return" || line == "ireturn") return "returns from inside the loop";
+        if(line != "" && line.rfind("/*hahahaha", 0) != 0) previous = line;
+    }
+    for(auto& it : reduced){
+        // every read of a reduction variable is the x of its own x = x + e
+        if(reads[it.first] != it.second) return "reads the reduction variable " + this->localName(it.first) + " outside of x = x + e";
+        reductions.push_back(it.first);
+    }
+    for(auto& it : reads){
+        if(!reduced.count(it.first)) captures.push_back(it.first);
+    }
+    return "";
+}
+
+// functions that can run inside a parallel foreach
+bool CodeGenerator::isPure(string block, string self){
+    stringstream ss(block);
+    string line;
+    while(getline(ss, line)){
+        if(line.find(".__prof_") != string::npos) continue;
+        if(line.rfind("putstatic ", 0) == 0 || this->isPrintReceiver(line)) return false;
+        if(line.rfind("new ", 0) == 0) return false;
+        if(line.rfind("invokestatic ", 0) == 0){
+            size_t space = line.find(' ', 13), paren = line.find('(');
+            string name = line.substr(space + 1, paren - space - 1);
+            size_t dot = name.rfind('.');
+            string callee = name.substr(dot + 1);
+            if(name.substr(0, dot) != this->className) return false;
+            if(callee != self && !this->pureFunctions.count(callee)) return false;
+        }
+    }
+    return true;
+}
+
+// name of a local slot in the current scopes, for error messages
+string CodeGenerator::localName(int slot){
+    for(SymbolTable* scope = sbt; scope != nullptr; scope = scope->parent){
+        for(auto& it : scope->table){
+            AstNode* entry = it.second;
+            if(!entry->isGlobal && !entry->isConst && !entry->isFunc && !entry->isArray && entry->number == slot) return it.first;
+        }
+    }
+    return "local " + to_string(slot);
+}
+
 void CodeGenerator::generateReturn(AstNode* node){
     if(node->dataType == DataType::VOID_T){
         this->jasmStk.push_back("return\n");
@@ -328,4 +835,431 @@ void CodeGenerator::generateReturn(AstNode* node){
         string exprBlock = this->jasmStk.back(); this->jasmStk.pop_back();
         this->jasmStk.push_back(exprBlock + "ireturn\n");
     }
-}
\ No newline at end of file
+}
+
+
+void CodeGenerator::setMethodSizeLimit(int bytes){
+    this->methodSizeLimit = bytes;
+}
+
+/*
+ * buffered output
+ * consecutive prints of literals and constants are merged into one print of the joined string,
+ * a println ends the run and becomes println of the whole run
+ * with the PrintWriter every print of the class goes to <class>.__out, a PrintWriter over a
+ * 64KB BufferedOutputStream of stdout without autoflush, created in <clinit> and flushed by a shutdown hook
+ */
+void CodeGenerator::setBufferedOutput(bool coalesce, bool writer){
+    this->coalescePrints = coalesce;
+    this->outputWriter = writer;
+}
+
+string CodeGenerator::printReceiver(){
+    if(this->outputWriter) return "getstatic java.io.PrintWriter " + this->className + ".__out\n";
+    return "getstatic java.io.PrintStream java.lang.System.out\n";
+}
+
+string CodeGenerator::printMethod(string method){
+    if(this->outputWriter) return "invokevirtual void java.io.PrintWriter." + method;
+    return "invokevirtual void java.io.PrintStream." + method;
+}
+
+bool CodeGenerator::isPrintReceiver(string line){
+    return line == "getstatic java.io.PrintStream java.lang.System.out" || line == "getstatic java.io.PrintWriter " + this->className + ".__out";
+}
+
+string CodeGenerator::coalesce(string block){
+    vector<string> lines;
+    stringstream ss(block);
+    string line;
+    while(getline(ss, line)) lines.push_back(line);
+
+    string receiver = this->printReceiver(), print = this->printMethod("print"), println = this->printMethod("println");
+    receiver.pop_back();
+    // text of receiver / constant / print(ln) at i, false if lines i..i+2 are not a print of a constant
+    auto constantPrint = [&](int i, string& text, bool& newline){
+        if(i + 2 >= (int)lines.size() || lines[i] != receiver) return false;
+        string value = lines[i + 1], call = lines[i + 2];
+        if(call.rfind(print + "(", 0) != 0 && call.rfind(println + "(", 0) != 0) return false;
+        if(value.rfind("ldc \"", 0) == 0 && call.find("(java.lang.String)") != string::npos) text = value.substr(5, value.size() - 6);
+        else if(value.rfind("sipush ", 0) == 0 && call.find("(int)") != string::npos) text = to_string(atoi(value.c_str() + 7));
+        else if((value == "iconst_0" || value == "iconst_1") && call.find("(boolean)") != string::npos) text = (value == "iconst_1") ? "true" : "false";
+        else return false;
+        newline = call.rfind(println + "(", 0) == 0;
+        return true;
+    };
+
+    string result = "";
+    for(int i=0; i<(int)lines.size(); ){
+        string text, joined = "";
+        bool newline = false;
+        int count = 0, j = i;
+        while(!newline && constantPrint(j, text, newline)){
+            joined += text;
+            count++;
+            j += 3;
+        }
+        if(count < 2){
+            result += lines[i] + "\n";
+            i++;
+            continue;
+        }
+        result += receiver + "\nldc \"" + joined + "\"\n" + (newline ? println : print) + "(java.lang.String)\n";
+        i = j;
+    }
+    return result;
+}
+
+/*
+ * read
+ * every read calls __read_int / __read_bool of the class, emitted once when the program reads
+ * they share a 64KB byte buffer over System.in, allocated by the first read,
+ * skip whitespace and parse the token by hand; a bool token is true if it starts with 't'
+ * at the end of input __read_int returns 0 and __read_bool false
+ * -fnaive-read lowers them to one lazily created java.util.Scanner instead, as a baseline
+ */
+void CodeGenerator::setReadHelpers(bool enable){
+    this->readHelpers = enable;
+}
+
+void CodeGenerator::setNaiveRead(bool enable){
+    this->naiveRead = enable;
+}
+
+string CodeGenerator::readFields(){
+    if(this->naiveRead) return "field static java.util.Scanner __in_scanner\n";
+    return "field static byte[] __in_buf\nfield static int __in_pos\nfield static int __in_len\n";
+}
+
+string CodeGenerator::readMethods(){
+    string cls = this->className + ".";
+    string head = "max_stack 8\nmax_locals 4\n{\n";
+    string jasm = "";
+    // pending output is flushed before blocking on System.in, as the VM and x86_64 runtimes do
+    string flush = this->outputWriter ? "invokestatic void " + cls + "__out_flush()\n" : "";
+    if(this->naiveRead){
+        string Lready = this->getNewLabel();
+        string scanner = "invokestatic java.util.Scanner " + cls + "__scanner()\n";
+        jasm += "method public static java.util.Scanner __scanner()\n" + head;
+        jasm += "getstatic java.util.Scanner " + cls + "__in_scanner\nifnonnull " + Lready + "\n";
+        jasm += "new java.util.Scanner\ndup\ngetstatic java.io.InputStream java.lang.System.in\n";
+        jasm += "invokespecial void java.util.Scanner.<init>(java.io.InputStream)\nputstatic java.util.Scanner " + cls + "__in_scanner\n";
+        jasm += Lready + ": \nnop\ngetstatic java.util.Scanner " + cls + "__in_scanner\nareturn\n}\n";
+        jasm += "method public static int __read_int()\n" + head + flush + scanner + "invokevirtual int java.util.Scanner.nextInt()\nireturn\n}\n";
+        jasm += "method public static bool __read_bool()\n" + head + flush + scanner + "invokevirtual boolean java.util.Scanner.nextBoolean()\nireturn\n}\n";
+        return jasm;
+    }
+
+    // __read_byte: next byte of System.in, -1 at the end of input
+    string Lhave = this->getNewLabel(), Lallocated = this->getNewLabel(), Lfilled = this->getNewLabel();
+    string buf = "getstatic byte[] " + cls + "__in_buf\n";
+    string pos = "getstatic int " + cls + "__in_pos\n";
+    jasm += "method public static int __read_byte()\n" + head;
+    jasm += pos + "getstatic int " + cls + "__in_len\nisub\niflt " + Lhave + "\n";
+    jasm += buf + "ifnonnull " + Lallocated + "\nldc 65536\nnewarray byte\nputstatic byte[] " + cls + "__in_buf\n";
+    jasm += Lallocated + ": \nnop\n" + flush + "getstatic java.io.InputStream java.lang.System.in\n" + buf + "iconst_0\nldc 65536\n";
+    jasm += "invokevirtual int java.io.InputStream.read(byte[], int, int)\ndup\nputstatic int " + cls + "__in_len\nifgt " + Lfilled + "\n";
+    jasm += "iconst_0\nputstatic int " + cls + "__in_len\niconst_m1\nireturn\n";
+    jasm += Lfilled + ": \nnop\niconst_0\nputstatic int " + cls + "__in_pos\n";
+    jasm += Lhave + ": \nnop\n" + buf + pos + "baload\n" + pos + "iconst_1\niadd\nputstatic int " + cls + "__in_pos\n";
+    jasm += "sipush 255\niand\nireturn\n}\n";
+
+    // skip whitespace into local 0, to Leof at the end of input
+    string next = "invokestatic int " + cls + "__read_byte()\nistore 0\n";
+    auto skip = [&](string Leof){
+        string Lskip = this->getNewLabel();
+        return Lskip + ": \nnop\n" + next + "iload 0\niflt " + Leof + "\niload 0\nsipush 32\nisub\nifle " + Lskip + "\n";
+    };
+
+    // __read_int: optional '-' and digits, local 1 value, local 2 negative
+    string Leof = this->getNewLabel(), Ldigits = this->getNewLabel(), Lend = this->getNewLabel(), Lpositive = this->getNewLabel();
+    jasm += "method public static int __read_int()\n" + head + skip(Leof);
+    jasm += "sipush 0\nistore 1\nsipush 0\nistore 2\n";
+    jasm += "iload 0\nsipush 45\nisub\nifne " + Ldigits + "\nsipush 1\nistore 2\n" + next;
+    jasm += Ldigits + ": \nnop\niload 0\nsipush 48\nisub\nistore 0\n";
+    jasm += "iload 0\niflt " + Lend + "\niload 0\nsipush 9\nisub\nifgt " + Lend + "\n";
+    jasm += "iload 1\nsipush 10\nimul\niload 0\niadd\nistore 1\n" + next + "goto " + Ldigits + "\n";
+    jasm += Lend + ": \nnop\niload 2\nifeq " + Lpositive + "\niload 1\nineg\nireturn\n";
+    jasm += Lpositive + ": \nnop\niload 1\nireturn\n";
+    jasm += Leof + ": \nnop\nsipush 0\nireturn\n}\n";
+
+    // __read_bool: first byte of the token in local 1
+    string Lfalse = this->getNewLabel(), Ltoken = this->getNewLabel();
+    jasm += "method public static bool __read_bool()\n" + head + skip(Lfalse) + "iload 0\nistore 1\n";
+    jasm += Ltoken + ": \nnop\ninvokestatic int " + cls + "__read_byte()\nsipush 32\nisub\nifgt " + Ltoken + "\n";
+    jasm += "iload 1\nsipush 116\nisub\nifne " + Lfalse + "\niconst_1\nireturn\n";
+    jasm += Lfalse + ": \nnop\niconst_0\nireturn\n}\n";
+    return jasm;
+}
+
+void CodeGenerator::setPromoteGlobals(bool enable){
+    this->promote = enable;
+}
+
+// globals of this class accessed by the block, directly or by the functions it calls
+set<string> CodeGenerator::touchedGlobals(string block, string self){
+    set<string> result;
+    string own = " int " + this->className + ".";
+    stringstream ss(block);
+    string line;
+    while(getline(ss, line)){
+        if(line.rfind("getstatic" + own, 0) == 0) result.insert(line.substr(9 + own.size()));
+        else if(line.rfind("putstatic" + own, 0) == 0) result.insert(line.substr(9 + own.size()));
+        else if(line.rfind("invokestatic ", 0) == 0){
+            size_t space = line.find(' ', 13), paren = line.find('(');
+            string name = line.substr(space + 1, paren - space - 1);
+            size_t dot = name.rfind('.');
+            string callee = name.substr(dot + 1);
+            if(name.substr(0, dot) == this->className && callee == self) continue; // recursion adds nothing new
+            auto it = this->globalSummary.find(callee);
+            if(name.substr(0, dot) != this->className || it == this->globalSummary.end()) result.insert("*");
+            else result.insert(it->second.begin(), it->second.end());
+        }
+    }
+    return result;
+}
+
+/*
+ * scalar promotion: globals of this class used in a loop and not touched by the calls in it
+ * are loaded into fresh local slots before the loop, accessed with iload/istore/iinc,
+ * and written back after the loop exit and before every return inside the loop
+ */
+string CodeGenerator::promoteGlobals(string loop){
+    if(!this->promote) return loop;
+    vector<string> lines;
+    stringstream ss(loop);
+    string line;
+    while(getline(ss, line)) lines.push_back(line);
+
+    // calls in the loop, the function being generated is not summarized yet
+    string calls = "";
+    for(string& l : lines){
+        if(l.rfind("invokestatic ", 0) == 0) calls += l + "\n";
+    }
+    set<string> blocked = this->touchedGlobals(calls, "");
+    if(blocked.count("*")) return loop;
+
+    string own = " int " + this->className + ".";
+    vector<string> promoted;    // in order of first use
+    set<string> written;
+    int maxSlot = sbt->counter - 1;
+    for(string& l : lines){
+        bool get = l.rfind("getstatic" + own, 0) == 0, put = l.rfind("putstatic" + own, 0) == 0;
+        if(get || put){
+            string field = l.substr(9 + own.size());
+            if(blocked.count(field) || field.rfind("__prof_", 0) == 0) continue; // counters must be current for the shutdown hook
+            if(find(promoted.begin(), promoted.end(), field) == promoted.end()) promoted.push_back(field);
+            if(put) written.insert(field);
+        }
+        if(l.rfind("iload ", 0) == 0 || l.rfind("istore ", 0) == 0 || l.rfind("iinc ", 0) == 0
+           || l.rfind("aload ", 0) == 0 || l.rfind("astore ", 0) == 0){
+            maxSlot = max(maxSlot, atoi(l.c_str() + l.find(' ') + 1));
+        }
+    }
+    if(promoted.empty()) return loop;
+
+    map<string, int> slotOf;
+    for(string& field : promoted) slotOf[field] = ++maxSlot;
+    string writeBack = "";
+    for(string& field : promoted){
+        if(written.count(field)) writeBack += "iload " + to_string(slotOf[field]) + "\nputstatic" + own + field + "\n";
+    }
+
+    vector<string> rewritten;
+    for(string& l : lines){
+        bool get = l.rfind("getstatic" + own, 0) == 0, put = l.rfind("putstatic" + own, 0) == 0;
+        string field = (get || put) ? l.substr(9 + own.size()) : "";
+        if(slotOf.count(field)) rewritten.push_back((get ? "iload " : "istore ") + to_string(slotOf[field]));
+        else rewritten.push_back(l);
+
+        // iload t, const, iadd/isub, istore t => iinc t const
+        int n = rewritten.size();
+        if(n >= 4 && rewritten[n - 4].rfind("iload ", 0) == 0 && rewritten[n - 1] == "istore " + rewritten[n - 4].substr(6)
+           && (rewritten[n - 2] == "iadd" || rewritten[n - 2] == "isub")){
+            string c = rewritten[n - 3];
+            int k;
+            if(c.rfind("iconst_", 0) == 0) k = (c == "iconst_m1") ? -1 : atoi(c.c_str() + 7);
+            else if(c.rfind("sipush ", 0) == 0 || c.rfind("bipush ", 0) == 0) k = atoi(c.c_str() + 7);
+            else continue;
+            if(rewritten[n - 2] == "isub") k = -k;
+            int slot = atoi(rewritten[n - 4].c_str() + 6);
+            if(slot <= maxSlot - (int)promoted.size() || k < -128 || k > 127) continue; // promoted slots only
+            rewritten.resize(n - 4);
+            rewritten.push_back("iinc " + to_string(slot) + " " + to_string(k));
+        }
+    }
+
+    string result = "";
+    for(string& field : promoted) result += "getstatic" + own + field + "\nistore " + to_string(slotOf[field]) + "\n";
+    for(string& l : rewritten){
+        if(l == "return" || l == "ireturn") result += writeBack;
+        result += l + "\n";
+    }
+    return result + writeBack;
+}
+
+
+/*
+ * execution count profile
+ * every instrumented construct gets a counter id in generation order,
+ * so the same source gives the same ids for -fprofile-generate and -fprofile-use
+ */
+void CodeGenerator::setProfileGenerate(bool enable){
+    this->profileGenerate = enable;
+}
+
+int CodeGenerator::newCounter(string kind, string name){
+    this->profileSites.push_back({kind, name, linenum});
+    return this->profileSites.size() - 1;
+}
+
+string CodeGenerator::counterInc(int id){
+    if(!this->profileGenerate) return "";
+    string field = this->className + ".__prof_" + to_string(id);
+    return "getstatic int " + field + "\niconst_1\niadd\nputstatic int " + field + "\n";
+}
+
+// count of the counter id in the loaded profile, 0 if the site does not match
+long long CodeGenerator::profileCount(int id){
+    if(id >= (int)this->loadedSites.size()) return 0;
+    if(this->loadedSites[id].kind != this->profileSites[id].kind) return 0;
+    return this->loadedCounts[id];
+}
+
+/*
+ * profile-guided local slot assignment (-fprofile-use)
+ * iload/istore of slots 0-3 take one byte instead of two, so the locals of a function are renumbered
+ * by the executions of the loops around their accesses, the hottest get the lowest slots after the parameters
+ */
+void CodeGenerator::weighSlots(string loop, int counter){
+    long long count = this->profileUse ? this->profileCount(counter) : 0;
+    if(count == 0) return;
+    stringstream ss(loop);
+    string line;
+    while(getline(ss, line)){
+        int slot = localSlot(line);
+        if(slot >= 0) this->slotWeight[slot] += count;
+    }
+}
+
+string CodeGenerator::assignSlots(string body, int params){
+    vector<string> lines;
+    set<int> used;
+    stringstream ss(body);
+    string line;
+    while(getline(ss, line)){
+        lines.push_back(line);
+        int slot = localSlot(line);
+        if(slot >= params) used.insert(slot);
+    }
+    // the same slots in order of weight, locals outside any hot loop keep their order
+    vector<int> slots(used.begin(), used.end());
+    vector<int> order = slots;
+    stable_sort(order.begin(), order.end(), [this](int a, int b){ return this->slotWeight[a] > this->slotWeight[b]; });
+    map<int, int> renamed;
+    for(size_t i = 0; i < slots.size(); i++) renamed[order[i]] = slots[i];
+
+    string result = "";
+    for(string& l : lines){
+        int slot = localSlot(l);
+        if(slot >= params && renamed[slot] != slot){
+            size_t space = l.find(' '), end = l.find(' ', space + 1);
+            l = l.substr(0, space + 1) + to_string(renamed[slot]) + (end == string::npos ? "" : l.substr(end));
+        }
+        result += l + "\n";
+    }
+    return result;
+}
+
+// register the static void method of this class as a JVM shutdown hook, wrapped as a Runnable like the parallel chunks
+// the hook also runs when the program ends by an exception
+string CodeGenerator::shutdownHook(string method){
+    string forName = "invokestatic java.lang.Class java.lang.Class.forName(java.lang.String)\n";
+    string jasm = "invokestatic java.lang.Runtime java.lang.Runtime.getRuntime()\nnew java.lang.Thread\ndup\n";
+    jasm += "ldc \"java.lang.Runnable\"\n" + forName;
+    jasm += "invokestatic java.lang.invoke.MethodHandles$Lookup java.lang.invoke.MethodHandles.lookup()\n";
+    jasm += "ldc \"" + this->className + "\"\n" + forName + "ldc \"" + method + "\"\n";
+    jasm += "getstatic java.lang.Class java.lang.Void.TYPE\n";
+    jasm += "invokestatic java.lang.invoke.MethodType java.lang.invoke.MethodType.methodType(java.lang.Class)\n";
+    jasm += "invokevirtual java.lang.invoke.MethodHandle java.lang.invoke.MethodHandles$Lookup.findStatic(java.lang.Class, java.lang.String, java.lang.invoke.MethodType)\n";
+    jasm += "invokestatic java.lang.Object java.lang.invoke.MethodHandleProxies.asInterfaceInstance(java.lang.Class, java.lang.invoke.MethodHandle)\n";
+    jasm += "invokespecial void java.lang.Thread.<init>(java.lang.Runnable)\n";
+    jasm += "invokevirtual void java.lang.Runtime.addShutdownHook(java.lang.Thread)\n";
+    return jasm;
+}
+
+// method __prof_dump: write "<id> <kind> <line> <name> <count>" of every counter to <class>.prof
+string CodeGenerator::profileDumpMethod(){
+    string jasm = "method public static void __prof_dump()\nmax_stack 4\nmax_locals 1\n{\n";
+    jasm += "new java.io.PrintStream\ndup\nldc \"" + this->className + ".prof\"\n";
+    jasm += "invokespecial void java.io.PrintStream.<init>(java.lang.String)\nastore 0\n";
+    for(int i=0; i<(int)this->profileSites.size(); i++){
+        ProfileSite& site = this->profileSites[i];
+        string head = to_string(i) + " " + site.kind + " " + to_string(site.line) + " " + site.name + " ";
+        jasm += "aload 0\nldc \"" + head + "\"\ninvokevirtual void java.io.PrintStream.print(java.lang.String)\n";
+        jasm += "aload 0\ngetstatic int " + this->className + ".__prof_" + to_string(i) + "\n";
+        jasm += "invokevirtual void java.io.PrintStream.println(int)\n";
+    }
+    jasm += "aload 0\ninvokevirtual void java.io.PrintStream.close()\nreturn\n}\n";
+    return jasm;
+}
+
+bool CodeGenerator::loadProfile(string path){
+    ifstream input(path);
+    if(!input) return false;
+    string line;
+    while(getline(input, line)){
+        stringstream ss(line);
+        int id;
+        ProfileSite site;
+        long long count;
+        if(!(ss >> id >> site.kind >> site.line >> site.name >> count)) continue;
+        if(id < 0) continue;
+        if(id >= (int)this->loadedSites.size()){
+            this->loadedSites.resize(id + 1, {"", "-", 0});
+            this->loadedCounts.resize(id + 1, 0);
+        }
+        this->loadedSites[id] = site;
+        this->loadedCounts[id] = count;
+    }
+    this->profileUse = true;
+    return true;
+}
+
+// print the hottest constructs of the loaded profile
+void CodeGenerator::reportProfile(int top){
+    if(this->loadedSites.size() != this->profileSites.size()){
+        cerr << "Warning: profile does not match the source, "
+             << this->loadedSites.size() << " counters in profile, " << this->profileSites.size() << " in source" << endl;
+    }
+    vector<int> ids;
+    for(int i=0; i<(int)this->profileSites.size(); i++) ids.push_back(i);
+    stable_sort(ids.begin(), ids.end(), [this](int a, int b){ return this->profileCount(a) > this->profileCount(b); });
+
+    cerr << "Hottest constructs:" << endl;
+    for(int i=0; i<top && i<(int)ids.size(); i++){
+        ProfileSite& site = this->profileSites[ids[i]];
+        if(this->profileCount(ids[i]) == 0) break;
+        cerr << "  " << this->profileCount(ids[i]) << "\t" << site.kind;
+        if(site.kind == "function") cerr << " " << site.name;
+        cerr << " (ends at line " << site.line << ")" << endl;
+    }
+}
+
+// static metrics of the generated methods on stderr, max_stack and max_locals are computed (the jasm declares 1000)
+void CodeGenerator::reportStats(){
+    JasmClass cls = parseJasm(this->getJasm());
+    cerr << left << setw(32) << "method" << right << " " << setw(8) << "insns" << " " << setw(8) << "bytes" << " " << setw(8) << "labels"
+         << " " << setw(10) << "max_stack" << " " << setw(10) << "max_locals" << endl;
+    for(JasmMethod& method : cls.methods){
+        int insns = 0, labels = 0;
+        for(JasmInsn& insn : method.body){
+            if(!insn.label.empty()) labels++;
+            else insns++;
+        }
+        cerr << left << setw(32) << method.name << right << " " << setw(8) << insns << " " << setw(8) << MethodSplitter::estimateSize(method.body)
+             << " " << setw(8) << labels << " " << setw(10) << MethodSplitter::maxStack(method.body)
+             << " " << setw(10) << MethodSplitter::maxLocals(method.body, method.paramTypes.size()) << endl;
+    }
+}
+
@@ -3,16 +3,26 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <set>
 #include "AST.hpp"
 #include "SymbolTable.hpp"
 
 using namespace std;
 
+// instrumented construct of the execution count profile
+struct ProfileSite{
+    string kind;    // function, loop, then, else
+    string name;    // function name, "-" if not a function
+    int line;       // source line where the construct ends
+};
+
 class CodeGenerator{
 public:
     CodeGenerator();
     CodeGenerator(string path);
     string dump();
+    string getJasm();
 
     void generateProgram();
     
@@ -34,12 +44,105 @@ public:
     void generateWhile(AstNode* node);
     void generateFor(AstNode* node);
     void generateForeach(AstNode* node);
+    string generateParallelForeach(AstNode* node);  // "" or the reason the loop cannot run in parallel
+    void generateRead(AstNode* node);
+
+    // local common subexpression elimination: -fcse
+    void setCse(bool enable);
+
+    // scalar promotion of globals in loops: -fpromote-globals
+    void setPromoteGlobals(bool enable);
+
+    // parallel foreach on the ForkJoinPool, sequential if disabled (targets other than the JVM)
+    void setParallel(bool enable);
+
+    // -fbuffered-output: merge prints of constants, and print through a class-level PrintWriter (JVM only)
+    void setBufferedOutput(bool coalesce, bool writer);
+
+    // methods over the limit (estimated bytes) are split into __split_<f>_<k> helpers, 0 disables
+    void setMethodSizeLimit(int bytes);
+
+    // read: buffered reader methods in the class, or a shared java.util.Scanner (-fnaive-read)
+    void setReadHelpers(bool enable);   // off for the VM and x86_64 targets, which provide __read_* themselves
+    void setNaiveRead(bool enable);
+
+    // profile: -fprofile-generate / -fprofile-use
+    void setProfileGenerate(bool enable);
+    bool loadProfile(string path);
+    void reportProfile(int top);
+
+    // --stats: instructions, estimated bytes, labels, max_stack and max_locals of every method
+    void reportStats();
 
 private:
     string className;
     string getNewLabel();
+    string qualifiedName(AstNode* node);
+    string exprCode(AstNode* node);
+
+    // cse state of the expression tree being generated
+    bool cse;
+    int cseDepth;                                   // nesting of exprDFS, 0 outside of an expression
+    int cseNextSlot;                                // next free local slot for temporaries
+    unordered_map<string, int> cseCount;            // occurrences of each pure subtree
+    unordered_map<string, int> cseSlot;             // available values, key => local slot
+    unordered_map<string, vector<string>> cseVars;  // variables read by each available value
+    string cseKey(AstNode* node, vector<string>& vars);
+    int cseSize(AstNode* node);
+    bool cseProfitable(AstNode* node, string key);
+    void cseCountTree(AstNode* node);
+    void cseKill(string var);
+
+    // globals read or written by each generated function, including its callees, "*" if unknown
+    bool promote;
+    unordered_map<string, set<string>> globalSummary;
+    set<string> touchedGlobals(string block, string self);
+    string promoteGlobals(string loop);
+
+    // parallel foreach
+    bool parallel;
+    int parallelCounter;
+    string outlined;                // methods outlined from parallel loops
+    set<string> pureFunctions;      // no global writes, print, or impure calls
+    bool isPure(string block, string self);
+    string parallelHazard(string body, int outer, int id, set<int> bounds, vector<int>& reductions, vector<int>& captures);
+    string localName(int slot);
+
+    // method splitting
+    int methodSizeLimit;
+    int splitRetFields;
+    bool splitExitFields;
+
+    // buffered output
+    bool coalescePrints;
+    bool outputWriter;
+    string printReceiver();             // getstatic of System.out or of the PrintWriter
+    string printMethod(string method);  // invokevirtual prefix of print/println
+    bool isPrintReceiver(string line);
+    string coalesce(string block);
+
+    // read
+    bool readHelpers;
+    bool naiveRead;
+    bool usesRead;
+    string readFields();
+    string readMethods();
     vector<string> jasmStk;
     int labelCounter;
+
+    bool profileGenerate;
+    bool profileUse;
+    vector<ProfileSite> profileSites;   // indexed by counter id
+    vector<ProfileSite> loadedSites;    // sites of the loaded profile, indexed by counter id
+    vector<long long> loadedCounts;
+    int newCounter(string kind, string name);
+    string counterInc(int id);
+    long long profileCount(int id);
+    string profileDumpMethod();
+    string shutdownHook(string method);
+    unordered_map<int, long long> slotWeight;   // -fprofile-use: executions of the loops around each local slot
+    void weighSlots(string loop, int counter);
+    string assignSlots(string body, int params);
 };
 
 
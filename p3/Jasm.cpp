@@ -0,0 +1,126 @@
+#include "Jasm.hpp"
+#include <string>
+#include <vector>
+#include <sstream>
+
+using namespace std;
+
+
+static string trim(string s){
+    size_t begin = s.find_first_not_of(" \t\r");
+    if(begin == string::npos) return "";
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+// remove /* ... */ comments, string literals are kept as is
+// a string literal is the operand of ldc and ends at the last quote of its line,
+// quotes inside are not escaped ("" of the source is a single quote in jasm)
+static string stripComments(string text){
+    string result = "";
+    for(size_t i=0; i<text.size(); i++){
+        if(text[i] == '\"'){
+            size_t eol = text.find('\n', i);
+            size_t close = text.rfind('\"', eol == string::npos ? string::npos : eol - 1);
+            result += text.substr(i, close - i + 1);
+            i = close;
+            continue;
+        }
+        if(text[i] == '/' && i + 1 < text.size() && text[i + 1] == '*'){
+            size_t close = text.find("*/", i + 2);
+            if(close == string::npos) break;
+            i = close + 1;
+            continue;
+        }
+        result += text[i];
+    }
+    return result;
+}
+
+static JasmInsn parseLine(string line){
+    JasmInsn insn;
+    size_t space = line.find_first_of(" \t");
+    string head = line.substr(0, space);
+    if(head.back() == ':'){
+        insn.label = head.substr(0, head.size() - 1);
+        return insn;
+    }
+    insn.op = head;
+    insn.arg = (space == string::npos) ? "" : trim(line.substr(space));
+    return insn;
+}
+
+vector<JasmInsn> parseJasmBody(string text){
+    vector<JasmInsn> body;
+    stringstream ss(stripComments(text));
+    string line;
+    while(getline(ss, line)){
+        line = trim(line);
+        if(line.empty()) continue;
+        body.push_back(parseLine(line));
+    }
+    return body;
+}
+
+void parseSignature(string sig, string& returnType, string& name, vector<string>& paramTypes){
+    size_t open = sig.find('('), close = sig.rfind(')');
+    stringstream head(sig.substr(0, open));
+    string word;
+    vector<string> words;
+    while(head >> word) words.push_back(word);
+    name = words.back();
+    returnType = words.size() >= 2 ? words[words.size() - 2] : "";
+
+    paramTypes.clear();
+    stringstream params(sig.substr(open + 1, close - open - 1));
+    string param;
+    while(getline(params, param, ',')){
+        param = trim(param);
+        if(!param.empty()) paramTypes.push_back(param);
+    }
+}
+
+JasmClass parseJasm(string text){
+    JasmClass cls;
+    stringstream ss(stripComments(text));
+    string line;
+    JasmMethod* method = nullptr;
+    bool inBody = false;
+    while(getline(ss, line)){
+        line = trim(line);
+        if(line.empty()) continue;
+
+        if(inBody){
+            if(line == "}"){
+                inBody = false;
+                method = nullptr;
+            }
+            else method->body.push_back(parseLine(line));
+            continue;
+        }
+
+        stringstream words(line);
+        string keyword;
+        words >> keyword;
+        if(keyword == "class") words >> cls.name;
+        else if(keyword == "field"){
+            // field static int name [= value]
+            JasmField field;
+            string modifier, eq;
+            words >> modifier >> field.type >> field.name;
+            field.isInit = (bool)(words >> eq >> field.value);
+            if(!field.isInit) field.value = 0;
+            cls.fields.push_back(field);
+        }
+        else if(keyword == "method"){
+            cls.methods.push_back(JasmMethod());
+            method = &cls.methods.back();
+            method->maxStack = method->maxLocals = 0;
+            parseSignature(line, method->returnType, method->name, method->paramTypes);
+        }
+        else if(keyword == "max_stack" && method) words >> method->maxStack;
+        else if(keyword == "max_locals" && method) words >> method->maxLocals;
+        else if(keyword == "{" && method) inBody = true;
+    }
+    return cls;
+}
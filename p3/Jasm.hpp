@@ -0,0 +1,49 @@
+#ifndef JASM_HPP
+#define JASM_HPP
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * reader of the jasm generated by CodeGenerator,
+ * used by the backends that do not go through javaa (e.g. the VM of --run)
+ */
+
+// one line of a method body, a label definition or an instruction
+typedef struct JasmInsn{
+    string label;   // label name, if the line defines a label
+    string op;      // opcode, empty for a label line
+    string arg;     // operand text, rest of the line
+} JasmInsn;
+
+typedef struct JasmField{
+    string name;
+    string type;
+    bool isInit;
+    int value;
+} JasmField;
+
+typedef struct JasmMethod{
+    string name;
+    string returnType;
+    vector<string> paramTypes;
+    int maxStack;
+    int maxLocals;
+    vector<JasmInsn> body;
+} JasmMethod;
+
+typedef struct JasmClass{
+    string name;
+    vector<JasmField> fields;
+    vector<JasmMethod> methods;
+} JasmClass;
+
+JasmClass parseJasm(string text);
+vector<JasmInsn> parseJasmBody(string text);
+
+// "int example.fib(int)" => name "example.fib", return type "int", param types {"int"}
+void parseSignature(string sig, string& returnType, string& name, vector<string>& paramTypes);
+
+#endif // JASM_HPP
@@ -0,0 +1,323 @@
+/*
+ * LexBench: differential test and throughput benchmark of the two lexers
+ * every input file is tokenized by the flex scanner (scanner.l) and SimdLexer,
+ * token code, yylval and line number must be identical for every token
+ * generated inputs cover the edges of the vector loops: blank and identifier runs longer than
+ * a vector, "" escapes at every offset of a 16/32 byte block, comments and strings left open at
+ * the end of input and input ending inside a vector
+ * usage: ./lexbench <sD file>...
+ */
+#include "AST.hpp"
+#include "lex.yy.cpp"
+#include "SimdLexer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+#if defined(__AVX2__)
+static const char* VECTOR_ISA = "AVX2";
+#elif defined(__SSE2__)
+static const char* VECTOR_ISA = "SSE2";
+#else
+static const char* VECTOR_ISA = "scalar";
+#endif
+
+YYSTYPE yylval;
+
+struct Token{
+    int code;
+    int line;
+    string value;
+};
+
+static string valueStr(int code, const YYSTYPE& lval){
+    if(code == ID || code == STR_VAL) return lval.strVal;
+    if(code == INT_VAL) return to_string(lval.intVal);
+    if(code == FLOAT_VAL){
+        char tmp[64];
+        snprintf(tmp, sizeof(tmp), "%.17g", lval.doubleVal);
+        return tmp;
+    }
+    return "";
+}
+
+// the start condition and line buffer of the scanner survive yy_delete_buffer, an open comment would leak into the next input
+static void flexReset(){
+    BEGIN INITIAL;
+    buf[0] = '\0';
+    linenum = 1;
+}
+
+static vector<Token> flexTokens(const string& text){
+    vector<Token> tokens;
+    flexReset();
+    YY_BUFFER_STATE state = yy_scan_bytes(text.data(), text.size());
+    int code;
+    do{
+        code = yylex();
+        tokens.push_back({code, linenum, valueStr(code, yylval)});
+    } while(code != 0);
+    yy_delete_buffer(state);
+    return tokens;
+}
+
+static vector<Token> simdTokens(const string& text){
+    vector<Token> tokens;
+    SimdLexer lexer(text.data(), text.size());
+    YYSTYPE lval;
+    int code;
+    do{
+        code = lexer.next(&lval);
+        tokens.push_back({code, lexer.line(), valueStr(code, lval)});
+    } while(code != 0);
+    return tokens;
+}
+
+// tokens per run, strings are freed since the parser owns them
+static size_t flexRun(const string& text){
+    size_t count = 0;
+    flexReset();
+    YY_BUFFER_STATE state = yy_scan_bytes(text.data(), text.size());
+    int code;
+    while((code = yylex()) != 0){
+        if(code == ID || code == STR_VAL) free(yylval.strVal);
+        count++;
+    }
+    yy_delete_buffer(state);
+    return count;
+}
+
+static size_t simdRun(const string& text){
+    size_t count = 0;
+    SimdLexer lexer(text.data(), text.size());
+    YYSTYPE lval;
+    int code;
+    while((code = lexer.next(&lval)) != 0){
+        if(code == ID || code == STR_VAL) free(lval.strVal);
+        count++;
+    }
+    return count;
+}
+
+template<typename F>
+static double throughput(const string& text, F run){
+    const int rounds = 5;
+    double best = 0;
+    for(int i = 0; i < rounds; i++){
+        auto begin = chrono::steady_clock::now();
+        run(text);
+        chrono::duration<double> sec = chrono::steady_clock::now() - begin;
+        best = max(best, text.size() / sec.count() / 1e6);
+    }
+    return best;
+}
+
+// tokens of the input, one per line, then the exit status
+// run in a child process, both lexers exit on a bad character (e.g. a string without closing quote)
+template<typename F>
+static string isolated(const string& text, F tokenize){
+    fflush(stdout);
+    int fd[2];
+    if(pipe(fd) != 0){
+        perror("pipe");
+        exit(1);
+    }
+    pid_t pid = fork();
+    if(pid == 0){
+        dup2(fd[1], 1);
+        close(fd[0]);
+        for(const Token& token : tokenize(text)) printf("%d '%s' line %d\n", token.code, token.value.c_str(), token.line);
+        fflush(stdout);
+        _exit(0);
+    }
+    close(fd[1]);
+    string out = "";
+    char chunk[4096];
+    ssize_t n;
+    while((n = read(fd[0], chunk, sizeof(chunk))) > 0) out.append(chunk, n);
+    close(fd[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return out + "exit " + to_string(WIFEXITED(status) ? WEXITSTATUS(status) : -1) + "\n";
+}
+
+// the line of text that contains byte i
+static string lineAt(const string& text, size_t i){
+    size_t begin = (i == 0) ? string::npos : text.rfind('\n', i - 1);
+    begin = (begin == string::npos) ? 0 : begin + 1;
+    return text.substr(begin, text.find('\n', begin) - begin);
+}
+
+static string escape(const string& text){
+    string out = "";
+    for(char c : text){
+        if(c == '\n') out += "\\n";
+        else if(c == '\t') out += "\\t";
+        else out += c;
+    }
+    return out;
+}
+
+struct EdgeCase{
+    string name;
+    vector<string> inputs;
+};
+
+// blank run of length n: spaces, tabs, or spaces with a newline every 7 bytes
+static string blanks(int n, int kind){
+    string run = "";
+    for(int i = 0; i < n; i++){
+        if(kind == 0) run += ' ';
+        else if(kind == 1) run += '\t';
+        else run += (i % 7 == 6) ? '\n' : ' ';
+    }
+    return run;
+}
+
+static vector<EdgeCase> edgeCases(){
+    vector<EdgeCase> cases;
+    const string idChars = "aZ_9bY0cX8dW1eV7fU2gT6hS3iR5jQ4";
+
+    EdgeCase blank = {"blank runs", {}};
+    for(int n = 1; n <= 96; n++){
+        for(int kind = 0; kind < 3; kind++){
+            blank.inputs.push_back("x" + blanks(n, kind) + "y;\n");
+            blank.inputs.push_back("x" + blanks(n, kind)); // input ends inside the run
+        }
+    }
+    cases.push_back(blank);
+
+    EdgeCase ident = {"identifier runs", {}};
+    for(int n = 1; n <= 100; n++){
+        string id = "q";
+        for(int i = 1; i < n; i++) id += idChars[i % idChars.size()];
+        ident.inputs.push_back("int " + id + " = " + id + "1;\n");
+        ident.inputs.push_back(id);
+        ident.inputs.push_back("println" + id.substr(1) + "(read);");
+    }
+    cases.push_back(ident);
+
+    // the string starts at every offset of a block, "" at every position of a 40 byte body
+    EdgeCase quote = {"\"\" escapes", {}};
+    for(int offset = 0; offset < 32; offset++){
+        for(int q = 0; q <= 40; q++){
+            string body = string(40, 's');
+            body.insert(q, "\"\"");
+            quote.inputs.push_back(string(offset, ' ') + "s = \"" + body + "\";\n");
+        }
+        quote.inputs.push_back(string(offset, ' ') + "s = \"" + string(40, '"') + "\" + \"\"\"\"\"\";");
+    }
+    cases.push_back(quote);
+
+    EdgeCase comment = {"comments at the end of input", {}};
+    for(int n = 0; n <= 80; n++){
+        string body = "";
+        for(int i = 0; i < n; i++) body += (i % 20 == 19) ? '\n' : (i % 5 == 4 ? '*' : 'c');
+        comment.inputs.push_back("a; /*" + body);
+        comment.inputs.push_back("a; /*" + body + "*");
+        comment.inputs.push_back("a; /*" + body + "*/");
+        comment.inputs.push_back("a; //" + body.substr(0, body.find('\n')));
+    }
+    cases.push_back(comment);
+
+    EdgeCase open = {"strings at the end of input", {}};
+    for(int n = 0; n <= 70; n++){
+        string body = string(n, 'o');
+        if(n >= 4) body.replace(n / 2, 2, "\"\"");
+        open.inputs.push_back("s = \"" + body);
+        open.inputs.push_back("s = \"" + body + "\"\"");
+    }
+    cases.push_back(open);
+
+    // every prefix of a program without strings, so the input ends at every offset of a vector
+    EdgeCase prefix = {"truncated input", {}};
+    string program = "int abc_def = 12345 + x1 * 3.25e2;   /* block\n comment */ foo(.5, 7.);\t// tail\n"
+                     "while(i <= 10 == (j != 2)) { i++; k--; }\nforeach(i : 1 .. 99) read   longer_identifier_name_0123456789;\n";
+    for(size_t n = 0; n <= program.size(); n++) prefix.inputs.push_back(program.substr(0, n));
+    cases.push_back(prefix);
+
+    return cases;
+}
+
+// compare the output of both lexers on every generated input, report the first mismatch of a case
+static bool compareEdgeCases(){
+    bool same = true;
+    for(const EdgeCase& edge : edgeCases()){
+        bool identical = true;
+        for(const string& input : edge.inputs){
+            string expect = isolated(input, flexTokens);
+            string actual = isolated(input, simdTokens);
+            if(expect == actual) continue;
+            size_t diff = 0;
+            while(diff < expect.size() && diff < actual.size() && expect[diff] == actual[diff]) diff++;
+            cout << "edge case " << edge.name << ": mismatch on \"" << escape(input) << "\"" << endl;
+            cout << "  flex: " << lineAt(expect, diff) << endl;
+            cout << "  simd: " << lineAt(actual, diff) << endl;
+            identical = false;
+            break;
+        }
+        if(identical) cout << "edge case " << edge.name << ": " << edge.inputs.size() << " inputs, identical" << endl;
+        same = same && identical;
+    }
+    return same;
+}
+
+int main(int argc, char* argv[]){
+    if(argc < 2){
+        printf("Usage: ./lexbench <sD filename>...\n");
+        exit(1);
+    }
+
+    bool same = compareEdgeCases();
+    string all = "";
+    for(int i = 1; i < argc; i++){
+        ifstream input(argv[i]);
+        if(!input){
+            perror(argv[i]);
+            exit(1);
+        }
+        stringstream ss;
+        ss << input.rdbuf();
+        string text = ss.str();
+        all += text + "\n";
+
+        vector<Token> expect = flexTokens(text);
+        vector<Token> actual = simdTokens(text);
+        size_t n = min(expect.size(), actual.size());
+        size_t diff = n;
+        for(size_t k = 0; k < n; k++){
+            if(expect[k].code != actual[k].code || expect[k].line != actual[k].line || expect[k].value != actual[k].value){
+                diff = k;
+                break;
+            }
+        }
+        if(diff == n && expect.size() == actual.size()){
+            cout << argv[i] << ": " << expect.size() << " tokens, identical" << endl;
+            continue;
+        }
+        same = false;
+        cout << argv[i] << ": mismatch at token " << diff << endl;
+        if(diff < expect.size()) cout << "  flex: " << expect[diff].code << " '" << expect[diff].value << "' line " << expect[diff].line << endl;
+        if(diff < actual.size()) cout << "  simd: " << actual[diff].code << " '" << actual[diff].value << "' line " << actual[diff].line << endl;
+    }
+
+    // throughput over the concatenated inputs, repeated to at least 16MB
+    string big = all;
+    while(big.size() < (16u << 20) && !all.empty()) big += all;
+    double flexMBs = throughput(big, flexRun);
+    double simdMBs = throughput(big, simdRun);
+    printf("flex : %8.1f MB/s\n", flexMBs);
+    printf("simd : %8.1f MB/s (%.2fx, %s)\n", simdMBs, simdMBs / flexMBs, VECTOR_ISA);
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,388 @@
+#include "MethodSplitter.hpp"
+#include "Jasm.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const int MIN_REGION = 32;       // smaller regions do not pay for the call
+static const int HELPER_MARGIN = 128;   // parameters and returns added to the outlined region
+static const int EXIT_COST = 8;         // a return in a helper also sets __split_exit and __split_value
+static const int CALL_COST = 16;        // estimated call site of a helper
+
+
+static bool isJump(const JasmInsn& insn){
+    return insn.op == "goto" || insn.op.rfind("if", 0) == 0;
+}
+
+static bool isExit(const JasmInsn& insn){
+    return insn.op == "return" || insn.op == "ireturn" || insn.op == "areturn";
+}
+
+static bool isLocal(const JasmInsn& insn){
+    return insn.op == "iload" || insn.op == "istore" || insn.op == "iinc" || insn.op == "aload" || insn.op == "astore";
+}
+
+// estimated bytes of the instruction in the class file
+static int insnSize(const JasmInsn& insn){
+    const string& op = insn.op;
+    if(op.empty()) return 0;
+    if(op == "iload" || op == "istore" || op == "aload" || op == "astore"){
+        int slot = atoi(insn.arg.c_str());
+        return slot <= 3 ? 1 : (slot <= 255 ? 2 : 4);
+    }
+    if(op == "iinc") return atoi(insn.arg.c_str()) <= 255 ? 3 : 6;
+    if(op == "bipush" || op == "newarray") return 2;
+    if(op == "sipush" || op == "ldc" || op == "getstatic" || op == "putstatic" || op == "invokestatic" || op == "invokevirtual"
+       || op == "invokespecial" || op == "new" || isJump(insn)) return 3; // ldc_w once the constant pool grows
+    return 1;
+}
+
+static int stackDelta(const JasmInsn& insn){
+    const string& op = insn.op;
+    if(op == "invokestatic" || op == "invokevirtual" || op == "invokespecial"){
+        string returnType, name;
+        vector<string> paramTypes;
+        parseSignature(insn.arg, returnType, name, paramTypes);
+        return (returnType != "void") - (int)paramTypes.size() - (op != "invokestatic");
+    }
+    if(op == "iload" || op == "aload" || op == "sipush" || op == "bipush" || op == "ldc" || op.rfind("iconst_", 0) == 0
+       || op == "getstatic" || op == "new" || op == "dup") return 1;
+    if(op == "istore" || op == "astore" || op == "putstatic" || op == "pop" || op == "ireturn" || op == "areturn"
+       || op == "iadd" || op == "isub" || op == "imul" || op == "idiv" || op == "irem" || op == "iand" || op == "ior"
+       || op == "ixor" || op == "baload" || (op != "goto" && isJump(insn))) return -1;
+    return 0;
+}
+
+// "5 1" of iinc => 5
+static int slotOf(const JasmInsn& insn){
+    return atoi(insn.arg.c_str());
+}
+
+// operand stack depth before every instruction (and at the end), -1 if unknown (after goto until a known label)
+static vector<int> stackDepths(vector<JasmInsn>& body){
+    int n = body.size();
+    vector<int> depth(n + 1, -1);
+    map<string, int> labelDepth;
+    int d = 0;
+    for(int i=0; i<n; i++){
+        JasmInsn& insn = body[i];
+        if(!insn.label.empty()){
+            if(labelDepth.count(insn.label)) d = labelDepth[insn.label];
+            else if(d >= 0) labelDepth[insn.label] = d;
+        }
+        depth[i] = d;
+        if(d < 0) continue;
+        d += stackDelta(insn);
+        if(isJump(insn) && !labelDepth.count(insn.arg)) labelDepth[insn.arg] = d;
+        if(insn.op == "goto" || isExit(insn)) d = -1;
+    }
+    depth[n] = d;
+    return depth;
+}
+
+static string toText(vector<JasmInsn>& body){
+    string text = "";
+    for(JasmInsn& insn : body){
+        if(!insn.label.empty()) text += insn.label + ": \n";
+        else text += insn.op + (insn.arg.empty() ? "" : " " + insn.arg) + "\n";
+    }
+    return text;
+}
+
+
+
+MethodSplitter::MethodSplitter(string className, int limit){
+    this->className = className;
+    this->limit = limit;
+    this->numRetFields = 0;
+    this->exitFields = false;
+    this->sizeBefore = this->sizeAfter = 0;
+    this->numHelpers = 0;
+    this->largestHelper = 0;
+}
+
+int MethodSplitter::estimateSize(vector<JasmInsn>& body){
+    int size = 0;
+    for(JasmInsn& insn : body) size += insnSize(insn);
+    return size;
+}
+
+// deepest operand stack of the body
+int MethodSplitter::maxStack(vector<JasmInsn>& body){
+    vector<int> depth = stackDepths(body);
+    int deepest = 0;
+    for(int i=0; i<(int)body.size(); i++){
+        if(depth[i] >= 0) deepest = max(deepest, max(depth[i], depth[i] + stackDelta(body[i])));
+    }
+    return deepest;
+}
+
+// local slots used by the body, at least the parameters
+int MethodSplitter::maxLocals(vector<JasmInsn>& body, int numParams){
+    int slots = numParams;
+    for(JasmInsn& insn : body){
+        if(isLocal(insn)) slots = max(slots, slotOf(insn) + 1);
+    }
+    return slots;
+}
+
+// live locals before every instruction (numWords bit words per instruction), backward dataflow until a fixed point
+void MethodSplitter::liveness(vector<JasmInsn>& body, vector<uint64_t>& liveIn, int& numWords){
+    int n = body.size(), numSlots = 1;
+    vector<int> target(n, -1);
+    map<string, int> labelPos;
+    for(int i=0; i<n; i++){
+        if(!body[i].label.empty()) labelPos[body[i].label] = i;
+        if(isLocal(body[i])) numSlots = max(numSlots, slotOf(body[i]) + 1);
+    }
+    for(int i=0; i<n; i++){
+        if(isJump(body[i])) target[i] = labelPos[body[i].arg];
+    }
+    int W = numWords = (numSlots + 63) / 64;
+    liveIn.assign((size_t)(n + 1) * W, 0);
+    vector<uint64_t> live(W);
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(int i=n-1; i>=0; i--){
+            JasmInsn& insn = body[i];
+            fill(live.begin(), live.end(), 0);
+            if(!isExit(insn)){
+                if(insn.op != "goto") copy(&liveIn[(size_t)(i + 1) * W], &liveIn[(size_t)(i + 2) * W], live.begin());
+                if(target[i] >= 0){
+                    for(int w=0; w<W; w++) live[w] |= liveIn[(size_t)target[i] * W + w];
+                }
+            }
+            if(isLocal(insn)){
+                int slot = slotOf(insn);
+                if(insn.op == "istore" || insn.op == "astore") live[slot / 64] &= ~(1ULL << (slot % 64));
+                else live[slot / 64] |= 1ULL << (slot % 64);
+            }
+            if(!equal(live.begin(), live.end(), &liveIn[(size_t)i * W])){
+                copy(live.begin(), live.end(), &liveIn[(size_t)i * W]);
+                changed = true;
+            }
+        }
+    }
+}
+
+/*
+ * disjoint regions [begin, end) of complete statements with size <= limit - margin, largest first,
+ * until they remove the excess over the limit
+ * a jump crossing a boundary p has one end before p and the other after it,
+ * both boundaries of a region must be crossed by the same jumps (those passing over the region),
+ * which is compared by a xor of random keys of the crossing jumps
+ */
+bool MethodSplitter::findRegions(vector<JasmInsn>& body, vector<pair<int, int>>& regions){
+    int n = body.size();
+    map<string, int> labelPos;
+    for(int i=0; i<n; i++){
+        if(!body[i].label.empty()) labelPos[body[i].label] = i;
+    }
+
+    vector<int> depth = stackDepths(body);
+
+    mt19937_64 random(n);
+    vector<uint64_t> crossing(n + 2, 0);
+    for(int i=0; i<n; i++){
+        if(!isJump(body[i]) || !labelPos.count(body[i].arg)) continue;
+        int lo = min(i, labelPos[body[i].arg]), hi = max(i, labelPos[body[i].arg]);
+        uint64_t key = random();
+        crossing[lo + 1] ^= key;
+        crossing[hi + 1] ^= key;
+    }
+
+    // boundaries with the same crossing jumps and no reference between them share a key
+    map<pair<uint64_t, int>, vector<int>> groups;
+    vector<int> size(n + 1, 0);
+    uint64_t h = 0;
+    int blocked = 0;
+    for(int p=0; p<=n; p++){
+        h ^= crossing[p];
+        if(p > 0){
+            JasmInsn& prev = body[p - 1];
+            size[p] = size[p - 1] + insnSize(prev) + (isExit(prev) ? EXIT_COST : 0);
+            if(prev.op == "aload" || prev.op == "astore" || prev.op == "new") blocked++;
+        }
+        // not between a helper call and the reads of its __split_ret/__split_exit fields
+        bool returning = p < n && body[p].op == "getstatic" && body[p].arg.find(".__split_") != string::npos;
+        if(depth[p] == 0 && !returning) groups[{h, blocked}].push_back(p);
+    }
+
+    // largest region ending at every boundary
+    int maxRegion = this->limit - HELPER_MARGIN;
+    if(maxRegion < MIN_REGION) return false;
+    vector<pair<int, int>> candidates;
+    for(auto& group : groups){
+        vector<int>& pos = group.second;
+        int a = 0;
+        for(int b=1; b<(int)pos.size(); b++){
+            while(size[pos[b]] - size[pos[a]] > maxRegion) a++;
+            if(a == b || size[pos[b]] - size[pos[a]] < MIN_REGION) continue;
+            if(pos[a] == 0 && pos[b] == n) continue;
+            candidates.push_back({pos[a], pos[b]});
+        }
+    }
+    sort(candidates.begin(), candidates.end(), [&](const pair<int, int>& x, const pair<int, int>& y){
+        int sx = size[x.second] - size[x.first], sy = size[y.second] - size[y.first];
+        return sx != sy ? sx > sy : x.first < y.first;
+    });
+
+    map<int, int> taken;     // begin => end of the chosen regions
+    int excess = size[n] - this->limit;
+    regions.clear();
+    // regions much smaller than the best wait for the next round, where they may span the new calls
+    int best = candidates.empty() ? 0 : size[candidates[0].second] - size[candidates[0].first];
+    for(auto& region : candidates){
+        if(excess <= 0 || size[region.second] - size[region.first] < best / 2) break;
+        auto next = taken.lower_bound(region.first);
+        if(next != taken.end() && next->first < region.second) continue;
+        if(next != taken.begin() && prev(next)->second > region.first) continue;
+        taken[region.first] = region.second;
+        excess -= size[region.second] - size[region.first] - CALL_COST;
+    }
+    for(auto it=taken.rbegin(); it!=taken.rend(); it++) regions.push_back(*it);
+    return !regions.empty();
+}
+
+string MethodSplitter::split(string name, string& text){
+    vector<JasmInsn> body = parseJasmBody(text);
+    this->sizeBefore = this->sizeAfter = estimateSize(body);
+    this->numHelpers = 0;
+    this->largestHelper = 0;
+    if(this->limit <= 0 || this->sizeBefore <= this->limit) return "";
+
+    // regions are outlined from the last one, so the positions of the others stay valid,
+    // and their liveness too (an outlined region reads and writes no more locals than before)
+    string helpers = "";
+    vector<pair<int, int>> regions;
+    bool progress = true;
+    while(progress && estimateSize(body) > this->limit && this->findRegions(body, regions)){
+        vector<uint64_t> liveIn;
+        int W;
+        this->liveness(body, liveIn, W);
+        progress = false;
+        for(auto& region : regions) progress = this->outline(name, body, region.first, region.second, liveIn, W, helpers) || progress;
+    }
+    this->sizeAfter = estimateSize(body);
+    if(this->numHelpers > 0) text = toText(body);
+    return helpers;
+}
+
+// replace [begin, end) of body with a call to a new helper, false if the call is not smaller
+bool MethodSplitter::outline(string name, vector<JasmInsn>& body, int begin, int end, vector<uint64_t>& liveIn, int W, string& helpers){
+    int numSlots = W * 64;
+    auto liveAt = [&](int p, int slot){ return (liveIn[(size_t)p * W + slot / 64] >> (slot % 64)) & 1; };
+    vector<bool> accessed(numSlots, false), written(numSlots, false);
+    for(int i=begin; i<end; i++){
+        if(!isLocal(body[i])) continue;
+        accessed[slotOf(body[i])] = true;
+        if(body[i].op == "istore" || body[i].op == "iinc") written[slotOf(body[i])] = true;
+    }
+    vector<int> params, returns;
+    map<int, int> slotMap;
+    for(int s=0; s<numSlots; s++){
+        if(accessed[s] && liveAt(begin, s)) params.push_back(s);
+        if(written[s] && liveAt(end, s)) returns.push_back(s);
+    }
+    for(int s : params){
+        int next = slotMap.size();
+        slotMap[s] = next;
+    }
+    for(int s=0; s<numSlots; s++){
+        int next = slotMap.size();
+        if(accessed[s] && !slotMap.count(s)) slotMap[s] = next;
+    }
+
+    string helperName = "__split_" + name + "_" + to_string(this->numHelpers++);
+    string returnType = returns.empty() ? "void" : "int";
+    string signature = returnType + " " + this->className + "." + helperName + "(";
+    for(int k=0; k<(int)params.size(); k++) signature += (k ? ", int" : "int");
+    signature += ")";
+
+    // returns inside the region: the helper sets __split_exit (and __split_value), the caller returns
+    bool exits = false, exitsValue = false;
+    for(int i=begin; i<end; i++){
+        exits = exits || isExit(body[i]);
+        exitsValue = exitsValue || body[i].op == "ireturn";
+    }
+    string field = "int " + this->className + ".";
+
+    // call site
+    vector<JasmInsn> call;
+    for(int s : params) call.push_back({"", "iload", to_string(s)});
+    call.push_back({"", "invokestatic", signature});
+    if(!returns.empty()) call.push_back({"", "istore", to_string(returns[0])});
+    for(int k=1; k<(int)returns.size(); k++){
+        call.push_back({"", "getstatic", field + "__split_ret_" + to_string(k - 1)});
+        call.push_back({"", "istore", to_string(returns[k])});
+    }
+    if(exits){
+        string Lcontinue = "L" + helperName;
+        call.push_back({"", "getstatic", field + "__split_exit"});
+        call.push_back({"", "ifeq", Lcontinue});
+        call.push_back({"", "iconst_0", ""});
+        call.push_back({"", "putstatic", field + "__split_exit"});
+        if(exitsValue){
+            call.push_back({"", "getstatic", field + "__split_value"});
+            call.push_back({"", "ireturn", ""});
+        }
+        else call.push_back({"", "return", ""});
+        call.push_back({Lcontinue, "", ""});
+        call.push_back({"", "nop", ""});
+    }
+    vector<JasmInsn> region(body.begin() + begin, body.begin() + end);
+    if(estimateSize(call) >= estimateSize(region)){
+        this->numHelpers--;
+        return false;
+    }
+
+    // helper: the region on renumbered locals, then the returned locals
+    vector<JasmInsn> helper;
+    vector<JasmInsn> leave;
+    if(returns.empty()) leave.push_back({"", "return", ""});
+    else{
+        leave.push_back({"", "iconst_0", ""});
+        leave.push_back({"", "ireturn", ""});
+    }
+    for(JasmInsn insn : region){
+        if(isLocal(insn)){
+            size_t space = insn.arg.find(' ');
+            insn.arg = to_string(slotMap[slotOf(insn)]) + (space == string::npos ? "" : insn.arg.substr(space));
+        }
+        if(!isExit(insn)){
+            helper.push_back(insn);
+            continue;
+        }
+        if(insn.op == "ireturn") helper.push_back({"", "putstatic", field + "__split_value"});
+        helper.push_back({"", "iconst_1", ""});
+        helper.push_back({"", "putstatic", field + "__split_exit"});
+        helper.insert(helper.end(), leave.begin(), leave.end());
+    }
+    for(int k=1; k<(int)returns.size(); k++){
+        helper.push_back({"", "iload", to_string(slotMap[returns[k]])});
+        helper.push_back({"", "putstatic", field + "__split_ret_" + to_string(k - 1)});
+    }
+    if(returns.empty()) helper.push_back({"", "return", ""});
+    else{
+        helper.push_back({"", "iload", to_string(slotMap[returns[0]])});
+        helper.push_back({"", "ireturn", ""});
+    }
+    this->numRetFields = max(this->numRetFields, (int)returns.size() - 1);
+    this->exitFields = this->exitFields || exits;
+    this->largestHelper = max(this->largestHelper, estimateSize(helper));
+
+    string head = "method public static " + returnType + " " + helperName + "(";
+    head += signature.substr(signature.find('(') + 1) + "\nmax_stack 1000\nmax_locals 1000\n{\n";
+    helpers += head + toText(helper) + "}\n";
+
+    body.erase(body.begin() + begin, body.begin() + end);
+    body.insert(body.begin() + begin, call.begin(), call.end());
+    return true;
+}
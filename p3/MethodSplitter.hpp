@@ -0,0 +1,47 @@
+#ifndef METHOD_SPLITTER_HPP
+#define METHOD_SPLITTER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Jasm.hpp"
+
+using namespace std;
+
+/*
+ * MethodSplitter: keep generated methods under a bytecode size limit
+ * HotSpot does not JIT-compile methods over HugeMethodLimit (8000 bytes),
+ * and a method over 64KB does not load at all
+ * the size of every jasm instruction is estimated, and while a method is over the limit
+ * the largest region that fits is outlined into __split_<method>_<k>:
+ * - a region has an empty operand stack at both ends and no jump into or out of it
+ * - locals live at the start of the region are passed as int parameters
+ * - locals written in the region and live after it are returned, the first one as the return value,
+ *   the others through the static fields __split_ret_<i>
+ * - a return inside the region sets __split_exit (and __split_value), the caller then returns
+ */
+class MethodSplitter{
+public:
+    MethodSplitter(string className, int limit);
+    string split(string name, string& body);    // split body in place, return the helper methods
+    static int estimateSize(vector<JasmInsn>& body);
+    static int maxStack(vector<JasmInsn>& body);
+    static int maxLocals(vector<JasmInsn>& body, int numParams);
+
+    int numRetFields;       // __split_ret_<i> fields needed by the helpers
+    bool exitFields;        // __split_exit and __split_value are needed
+    int sizeBefore;         // of the last split method
+    int sizeAfter;
+    int numHelpers;
+    int largestHelper;
+
+private:
+    string className;
+    int limit;
+
+    bool findRegions(vector<JasmInsn>& body, vector<pair<int, int>>& regions);
+    bool outline(string name, vector<JasmInsn>& body, int begin, int end, vector<uint64_t>& liveIn, int numWords, string& helpers);
+    void liveness(vector<JasmInsn>& body, vector<uint64_t>& liveIn, int& numWords);
+};
+
+#endif // METHOD_SPLITTER_HPP
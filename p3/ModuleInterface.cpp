@@ -0,0 +1,170 @@
+#include "ModuleInterface.hpp"
+#include "SymbolTable.hpp"
+#include "AST.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+ModuleInterface::ModuleInterface(){
+    this->base = nullptr;
+    this->size = 0;
+    this->header = nullptr;
+    this->records = nullptr;
+    this->paramTypes = nullptr;
+    this->strings = nullptr;
+}
+
+ModuleInterface::~ModuleInterface(){
+    if(this->base) munmap(this->base, this->size);
+}
+
+bool ModuleInterface::fail(string msg){
+    this->error = msg;
+    return false;
+}
+
+bool ModuleInterface::open(string path, string module){
+    this->module = module;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) return this->fail("cannot open " + path);
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(SdiHeader)){
+        close(fd);
+        return this->fail("malformed interface " + path);
+    }
+    this->size = st.st_size;
+    this->base = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(this->base == MAP_FAILED){
+        this->base = nullptr;
+        return this->fail("cannot map " + path);
+    }
+
+    const char* p = (const char*)this->base;
+    this->header = (const SdiHeader*)p;
+    if(this->header->magic != SDI_MAGIC) return this->fail("not an interface file: " + path);
+    if(this->header->version != SDI_VERSION) return this->fail("interface version mismatch: " + path);
+    size_t expect = sizeof(SdiHeader) + (size_t)this->header->numRecords * sizeof(SdiRecord)
+                  + this->header->numParams + this->header->stringsSize;
+    if(expect != this->size || this->header->stringsSize == 0) return this->fail("malformed interface " + path);
+
+    this->records = (const SdiRecord*)(p + sizeof(SdiHeader));
+    this->paramTypes = (const uint8_t*)(this->records + this->header->numRecords);
+    this->strings = (const char*)(this->paramTypes + this->header->numParams);
+    if(this->strings[this->header->stringsSize - 1] != '\0') return this->fail("malformed interface " + path);
+    for(uint32_t i=0; i<this->header->numRecords; i++){
+        const SdiRecord& r = this->records[i];
+        if(r.name >= this->header->stringsSize || r.sVal >= this->header->stringsSize
+           || (size_t)r.firstParam + r.numParams > this->header->numParams){
+            return this->fail("malformed interface " + path);
+        }
+    }
+    return true;
+}
+
+AstNode* ModuleInterface::lookup(string name){
+    if(this->header == nullptr) return nullptr;
+    auto it = this->cache.find(name);
+    if(it != this->cache.end()) return it->second;
+
+    // binary search, records are sorted by name
+    int lo = 0, hi = (int)this->header->numRecords - 1;
+    const SdiRecord* found = nullptr;
+    while(lo <= hi){
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(name.c_str(), this->strings + this->records[mid].name);
+        if(cmp == 0){ found = &this->records[mid]; break; }
+        if(cmp < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    if(found == nullptr) return nullptr;
+
+    AstNode* node = makeNode();
+    node->name = name;
+    node->module = this->module;
+    node->dataType = (DataType)found->dataType;
+    if(found->kind == SDI_CONST){
+        node->isConst = true;
+        node->isInit = true;
+        node->iVal = found->iVal;
+        node->bVal = found->iVal;
+        node->sVal = this->strings + found->sVal;
+    }
+    else if(found->kind == SDI_VAR){
+        node->isGlobal = true;
+    }
+    else{
+        node->isFunc = true;
+        for(int i=0; i<found->numParams; i++){
+            AstNode* param = makeNode();
+            param->dataType = (DataType)this->paramTypes[found->firstParam + i];
+            node->paramList.push_back(param);
+        }
+    }
+    this->cache[name] = node;
+    return node;
+}
+
+
+bool ModuleInterface::write(string path, SymbolTable* sbt){
+    vector<string> names;
+    for(string& id : sbt->identifiers){
+        AstNode* entry = sbt->table[id];
+        if(entry->isArray || entry->name == "main") continue; // arrays are not supported by codegen
+        if(!entry->module.empty()) continue;
+        names.push_back(id);
+    }
+    sort(names.begin(), names.end());
+
+    string strings(1, '\0'); // offset 0 is the empty string
+    vector<SdiRecord> records;
+    vector<uint8_t> paramTypes;
+    for(string& id : names){
+        AstNode* entry = sbt->table[id];
+        SdiRecord r;
+        memset(&r, 0, sizeof(r));
+        r.name = strings.size();
+        strings += id + '\0';
+        r.dataType = (uint8_t)entry->dataType;
+        if(entry->isFunc){
+            r.kind = SDI_FUNC;
+            r.numParams = entry->paramList.size();
+            r.firstParam = paramTypes.size();
+            for(AstNode* param : entry->paramList) paramTypes.push_back((uint8_t)param->dataType);
+        }
+        else if(entry->isConst){
+            r.kind = SDI_CONST;
+            r.iVal = entry->iVal;
+            if(entry->dataType == DataType::STRING_T){
+                r.sVal = strings.size();
+                strings += entry->sVal + '\0';
+            }
+        }
+        else r.kind = SDI_VAR;
+        records.push_back(r);
+    }
+
+    SdiHeader header;
+    header.magic = SDI_MAGIC;
+    header.version = SDI_VERSION;
+    header.numRecords = records.size();
+    header.numParams = paramTypes.size();
+    header.stringsSize = strings.size();
+
+    ofstream output(path, ios::binary);
+    if(!output) return false;
+    output.write((const char*)&header, sizeof(header));
+    output.write((const char*)records.data(), records.size() * sizeof(SdiRecord));
+    output.write((const char*)paramTypes.data(), paramTypes.size());
+    output.write(strings.data(), strings.size());
+    output.close();
+    return (bool)output;
+}
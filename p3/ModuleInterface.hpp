@@ -0,0 +1,71 @@
+#ifndef MODULE_INTERFACE_HPP
+#define MODULE_INTERFACE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "AST.hpp"
+
+using namespace std;
+
+class SymbolTable;
+
+/*
+ * ModuleInterface: binary interface file (.sdi) of a compiled module, used by extern
+ * layout: header | records sorted by name | param types | string table
+ * - functions: return type and param types
+ * - constants: type and value (inlined by the importer)
+ * - global variables: type (accessed by getstatic/putstatic on the module class)
+ * the file is mmap-ed and searched by binary search, symbols are materialized on lookup
+ */
+
+#define SDI_MAGIC   0x49445373  // "sSDI"
+#define SDI_VERSION 1
+
+typedef struct SdiHeader{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numRecords;
+    uint32_t numParams;
+    uint32_t stringsSize;
+} SdiHeader;
+
+typedef struct SdiRecord{
+    uint32_t name;          // offset in string table
+    uint8_t  kind;          // SDI_CONST, SDI_VAR, SDI_FUNC
+    uint8_t  dataType;      // DataType
+    uint16_t numParams;
+    uint32_t firstParam;    // index in param types
+    int32_t  iVal;          // int/bool constant
+    uint32_t sVal;          // string constant, offset in string table
+} SdiRecord;
+
+enum SdiKind{ SDI_CONST, SDI_VAR, SDI_FUNC };
+
+class ModuleInterface{
+public:
+    ModuleInterface();
+    ~ModuleInterface();
+    bool open(string path, string module);  // false if missing or malformed, see error
+    AstNode* lookup(string name);           // nullptr if the module does not export name
+    string module;
+    string error;
+
+    // write the exported globals of sbt to path
+    static bool write(string path, SymbolTable* sbt);
+
+private:
+    void* base;
+    size_t size;
+    const SdiHeader* header;
+    const SdiRecord* records;
+    const uint8_t* paramTypes;
+    const char* strings;
+    unordered_map<string, AstNode*> cache;
+
+    bool fail(string msg);
+};
+
+#endif // MODULE_INTERFACE_HPP
@@ -0,0 +1,333 @@
+#include "SimdLexer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// zero bytes appended to the input, so the vector loops never read outside the buffer
+static const int PADDING = 64;
+
+
+/*
+ * character classification helpers
+ * every helper scans [p, end) and returns a pointer in [p, end]
+ */
+
+// first byte equal to c, or end
+static const char* findByte(const char* p, const char* end, char c){
+#if defined(__AVX2__)
+    __m256i needle32 = _mm256_set1_epi8(c);
+    while(end - p >= 32){
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle32));
+        if(mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i needle16 = _mm_set1_epi8(c);
+    while(end - p >= 16){
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle16));
+        if(mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while(p < end && *p != c) p++;
+    return p;
+}
+
+// number of byte c in [p, end)
+static int countByte(const char* p, const char* end, char c){
+    int count = 0;
+#if defined(__AVX2__)
+    __m256i needle32 = _mm256_set1_epi8(c);
+    while(end - p >= 32){
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle32)));
+        p += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i needle16 = _mm_set1_epi8(c);
+    while(end - p >= 16){
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle16)));
+        p += 16;
+    }
+#endif
+    while(p < end) count += (*p++ == c);
+    return count;
+}
+
+// skip ' ', '\t' and '\n', newline count is added to *lines
+static const char* skipBlank(const char* p, const char* end, int* lines){
+#if defined(__AVX2__)
+    __m256i sp32 = _mm256_set1_epi8(' '), tab32 = _mm256_set1_epi8('\t'), nl32 = _mm256_set1_epi8('\n');
+    while(end - p >= 32){
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i nl = _mm256_cmpeq_epi8(v, nl32);
+        __m256i blank = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp32), _mm256_cmpeq_epi8(v, tab32)), nl);
+        unsigned nlMask = _mm256_movemask_epi8(nl);
+        unsigned other = ~(unsigned)_mm256_movemask_epi8(blank);
+        if(other){
+            int idx = __builtin_ctz(other);
+            *lines += __builtin_popcount(nlMask & ((1u << idx) - 1));
+            return p + idx;
+        }
+        *lines += __builtin_popcount(nlMask);
+        p += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i sp16 = _mm_set1_epi8(' '), tab16 = _mm_set1_epi8('\t'), nl16 = _mm_set1_epi8('\n');
+    while(end - p >= 16){
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i nl = _mm_cmpeq_epi8(v, nl16);
+        __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp16), _mm_cmpeq_epi8(v, tab16)), nl);
+        unsigned nlMask = _mm_movemask_epi8(nl);
+        unsigned other = ~(unsigned)_mm_movemask_epi8(blank) & 0xffff;
+        if(other){
+            int idx = __builtin_ctz(other);
+            *lines += __builtin_popcount(nlMask & ((1u << idx) - 1));
+            return p + idx;
+        }
+        *lines += __builtin_popcount(nlMask);
+        p += 16;
+    }
+#endif
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\n')){
+        if(*p == '\n') (*lines)++;
+        p++;
+    }
+    return p;
+}
+
+static bool isIdChar(char c){
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// first byte that is not [A-Za-z0-9_], or end
+static const char* skipIdChars(const char* p, const char* end){
+#if defined(__SSE2__)
+    // signed compare, bytes >= 0x80 are negative and never in range
+    __m128i lo = _mm_set1_epi8('a' - 1), hi = _mm_set1_epi8('z' + 1);
+    __m128i LO = _mm_set1_epi8('A' - 1), HI = _mm_set1_epi8('Z' + 1);
+    __m128i d0 = _mm_set1_epi8('0' - 1), d9 = _mm_set1_epi8('9' + 1);
+    __m128i us = _mm_set1_epi8('_');
+    while(end - p >= 16){
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, LO), _mm_cmplt_epi8(v, HI));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, d0), _mm_cmplt_epi8(v, d9));
+        __m128i id = _mm_or_si128(_mm_or_si128(lower, upper), _mm_or_si128(digit, _mm_cmpeq_epi8(v, us)));
+        unsigned other = ~(unsigned)_mm_movemask_epi8(id) & 0xffff;
+        if(other) return p + __builtin_ctz(other);
+        p += 16;
+    }
+#endif
+    while(p < end && isIdChar(*p)) p++;
+    return p;
+}
+
+static bool isDigit(char c){
+    return c >= '0' && c <= '9';
+}
+
+static const char* skipDigits(const char* p, const char* end){
+    while(p < end && isDigit(*p)) p++;
+    return p;
+}
+
+
+
+SimdLexer::SimdLexer(FILE* fp){
+    char chunk[1 << 16];
+    size_t n;
+    while((n = fread(chunk, 1, sizeof(chunk), fp)) > 0){
+        this->text.insert(this->text.end(), chunk, chunk + n);
+    }
+    this->init();
+}
+
+SimdLexer::SimdLexer(const char* text, size_t len){
+    this->text.assign(text, text + len);
+    this->init();
+}
+
+void SimdLexer::init(){
+    size_t len = this->text.size();
+    this->text.resize(len + PADDING, '\0');
+    this->cur = this->text.data();
+    this->end = this->text.data() + len;
+    this->linenum = 1;
+}
+
+int SimdLexer::line(){
+    return this->linenum;
+}
+
+void SimdLexer::badCharacter(){
+    char c[2] = {*this->cur, '\0'};
+    printf("bad character: %s\n", c);
+    exit(-1);
+}
+
+
+/*
+ * integer, real: longest match of
+ *   {digits} | {digits}"."{digits}? | "."{digits} followed by optional [Ee]{digits}
+ */
+int SimdLexer::lexNumber(YYSTYPE* lval){
+    const char* p = this->cur;
+    bool isReal = false;
+    if(*p == '.'){
+        p = skipDigits(p + 1, this->end);
+        isReal = true;
+    }
+    else{
+        p = skipDigits(p, this->end);
+        if(p < this->end && *p == '.'){
+            p = skipDigits(p + 1, this->end);
+            isReal = true;
+        }
+    }
+    if(p + 1 < this->end && (*p == 'e' || *p == 'E') && isDigit(p[1])){
+        p = skipDigits(p + 1, this->end);
+        isReal = true;
+    }
+
+    const char* begin = this->cur;
+    this->cur = p;
+    if(isReal){
+        // atof may read further than the token (e.g. "1.5e+3"), use a terminated copy
+        lval->doubleVal = atof(string(begin, p).c_str());
+        return FLOAT_VAL;
+    }
+    lval->intVal = atoi(begin); // stops at the first non digit
+    return INT_VAL;
+}
+
+
+/* string: \"([^\"]|\"\")*\", "" is the escape of a double quote */
+int SimdLexer::lexString(YYSTYPE* lval){
+    const char* p = this->cur + 1;
+    const char* close;
+    while(true){
+        close = findByte(p, this->end, '\"');
+        if(close == this->end) this->badCharacter(); // no closing quote, flex falls back to rule '.'
+        if(close + 1 < this->end && close[1] == '\"'){
+            p = close + 2;
+            continue;
+        }
+        break;
+    }
+
+    int len = close + 1 - this->cur;
+    char* tmp = (char*)malloc((len + 1) * sizeof(char));
+    char* out = tmp;
+    p = this->cur + 1;
+    while(p < close){
+        const char* quote = findByte(p, close, '\"');
+        memcpy(out, p, quote - p);
+        out += quote - p;
+        if(quote == close) break;
+        *out++ = '\"';
+        p = quote + 2;
+    }
+    *out = '\0';
+
+    this->cur = close + 1;
+    lval->strVal = tmp;
+    return STR_VAL;
+}
+
+
+int SimdLexer::lexKeywordOrId(YYSTYPE* lval){
+    static const struct { const char* word; int token; } keywords[] = {
+        {"extern", EXTERN},   {"const", CONST},       {"void", VOID_TYPE},    {"char", CHAR_TYPE},
+        {"string", STRING_TYPE}, {"bool", BOOL_TYPE}, {"int", INT_TYPE},      {"float", FLOAT_TYPE},
+        {"double", DOUBLE_TYPE}, {"true", TRUE},      {"false", FALSE},       {"if", IF},
+        {"else", ELSE},       {"switch", SWITCH},     {"case", CASE},         {"default", DEFAULT},
+        {"do", DO},           {"while", WHILE},       {"for", FOR},           {"foreach", FOREACH},
+        {"break", BREAK},     {"continue", CONTINUE}, {"return", RETURN},     {"print", PRINT},
+        {"println", PRINTLN}, {"read", READ},         {"parallel", PARALLEL}
+    };
+
+    const char* begin = this->cur;
+    const char* p = skipIdChars(begin + 1, this->end);
+    size_t len = p - begin;
+    this->cur = p;
+
+    for(const auto& kw : keywords){
+        if(kw.word[0] == begin[0] && strlen(kw.word) == len && memcmp(kw.word, begin, len) == 0) return kw.token;
+    }
+    lval->strVal = (char*)malloc(len + 1);
+    memcpy(lval->strVal, begin, len);
+    lval->strVal[len] = '\0';
+    return ID;
+}
+
+
+int SimdLexer::next(YYSTYPE* lval){
+    while(true){
+        this->cur = skipBlank(this->cur, this->end, &this->linenum);
+        if(this->cur >= this->end){
+            this->linenum++; // same as yywrap()
+            return 0;
+        }
+
+        const char* p = this->cur;
+        char c = *p;
+        char n = (p + 1 < this->end) ? p[1] : '\0';
+
+        // comments
+        if(c == '/' && n == '/'){
+            this->cur = findByte(p + 2, this->end, '\n');
+            continue;
+        }
+        if(c == '/' && n == '*'){
+            const char* q = p + 2;
+            while(true){
+                const char* star = findByte(q, this->end, '*');
+                if(star == this->end || (star + 1 < this->end && star[1] == '/')){
+                    this->linenum += countByte(p + 2, star, '\n');
+                    this->cur = (star == this->end) ? this->end : star + 2;
+                    break;
+                }
+                q = star + 1;
+            }
+            continue;
+        }
+
+        if(c == '\"') return this->lexString(lval);
+        if(isDigit(c) || (c == '.' && isDigit(n))) return this->lexNumber(lval);
+        if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') return this->lexKeywordOrId(lval);
+
+        // two character operators
+        this->cur = p + 2;
+        if(c == '.' && n == '.') return RANGE_OP;
+        if(c == '+' && n == '+') return INC;
+        if(c == '-' && n == '-') return DEC;
+        if(c == '<' && n == '=') return LE;
+        if(c == '>' && n == '=') return GE;
+        if(c == '=' && n == '=') return EQ;
+        if(c == '!' && n == '=') return NEQ;
+        if(c == '&' && n == '&') return LOGICAL_AND;
+        if(c == '|' && n == '|') return LOGICAL_OR;
+
+        // single character tokens
+        this->cur = p + 1;
+        if(strchr(".,:;()[]{}+-*/%=<>!", c) && c != '\0') return c;
+
+        this->cur = p;
+        this->badCharacter();
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef SIMD_LEXER_HPP
+#define SIMD_LEXER_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "AST.hpp"      // y.tab.hpp needs AstNode and DataType
+#include "y.tab.hpp"    // token codes and YYSTYPE
+
+using namespace std;
+
+/*
+ * SimdLexer:
+ * hand-written replacement of the flex scanner (scanner.l),
+ * produce the same token stream, yylval values and line number.
+ * whitespace, comments and string bodies are skipped 16/32 bytes at a time
+ * with SSE2/AVX2 when the compiler enables them, otherwise scalar loops are used
+ */
+class SimdLexer{
+public:
+    SimdLexer(FILE* fp);
+    SimdLexer(const char* text, size_t len);
+
+    int next(YYSTYPE* lval);   // return token code, 0 on end of input
+    int line();                // same value as linenum of the flex scanner
+
+private:
+    vector<char> text;  // input, padded with zero bytes for vector loads
+    const char* cur;
+    const char* end;
+    int linenum;
+    bool eof;
+
+    void init();
+    int lexNumber(YYSTYPE* lval);
+    int lexString(YYSTYPE* lval);
+    int lexKeywordOrId(YYSTYPE* lval);
+    void badCharacter();
+};
+
+#endif // SIMD_LEXER_HPP
@@ -19,6 +19,9 @@ SymbolTable::~SymbolTable(){
     for(SymbolTable* child : children){
         delete child;
     }
+    for(ModuleInterface* module : modules){
+        delete module;
+    }
 }
 
 
@@ -28,12 +31,19 @@ AstNode* SymbolTable::lookup(string s) {
     if (it != table.end()) return it->second;
 
     SymbolTable* ptr = this->parent;
+    SymbolTable* global = this;
     while (ptr) {
         auto it2 = ptr->table.find(s);
         if (it2 != ptr->table.end()) return it2->second;
+        global = ptr;
         ptr = ptr->parent;
     }
 
+    // not declared in this file, search the extern modules in import order
+    for (ModuleInterface* module : global->modules) {
+        AstNode* entry = module->lookup(s);
+        if (entry) return entry;
+    }
     return nullptr;
 }
 
@@ -5,6 +5,7 @@
 #include <vector>
 #include <unordered_map>
 #include "AST.hpp"   // for AstNode
+#include "ModuleInterface.hpp"
 
 using namespace std;
 
@@ -16,6 +17,7 @@ public:
     SymbolTable* parent;
     vector<SymbolTable*> children;
     vector<string> identifiers; // for insert order
+    vector<ModuleInterface*> modules; // extern modules, searched after the global scope
 
     SymbolTable(bool isGlobal);
     ~SymbolTable();
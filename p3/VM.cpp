@@ -0,0 +1,489 @@
+#include "VM.hpp"
+#include "Jasm.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// condition order of CMP_*, BR_* and IF_*: lt, gt, le, ge, eq, ne
+enum VMOp{
+    OP_PUSH, OP_LOAD, OP_STORE, OP_INC, OP_GETG, OP_PUTG,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_REM, OP_NEG, OP_AND, OP_OR, OP_XOR,
+    OP_CMPLT, OP_CMPGT, OP_CMPLE, OP_CMPGE, OP_CMPEQ, OP_CMPNE,     // push (a - b) cond 0
+    OP_BRLT, OP_BRGT, OP_BRLE, OP_BRGE, OP_BREQ, OP_BRNE,           // branch if (a - b) cond 0
+    OP_IFLT, OP_IFGT, OP_IFLE, OP_IFGE, OP_IFEQ, OP_IFNE,           // branch if a cond 0
+    OP_GOTO, OP_DUP, OP_POP, OP_SWAP,
+    OP_CALL, OP_RET, OP_IRET,
+    OP_PRINT_INT, OP_PRINT_BOOL, OP_PRINT_STR,
+    OP_PRINTLN_INT, OP_PRINTLN_BOOL, OP_PRINTLN_STR,
+    OP_READ_INT, OP_READ_BOOL,
+    OP_COUNT
+};
+
+static const int STACK_SIZE  = 1 << 20;
+static const int LOCALS_SIZE = 1 << 22;
+static const int MAX_DEPTH   = 1 << 18;
+
+static int condIndex(string op){
+    if(op == "iflt") return 0;
+    if(op == "ifgt") return 1;
+    if(op == "ifle") return 2;
+    if(op == "ifge") return 3;
+    if(op == "ifeq") return 4;
+    if(op == "ifne") return 5;
+    return -1;
+}
+
+static int negateCond(int cond){
+    static const int neg[] = {3, 2, 1, 0, 5, 4};
+    return neg[cond];
+}
+
+static int32_t wrapAdd(int32_t a, int32_t b){ return (int32_t)((uint32_t)a + (uint32_t)b); }
+static int32_t wrapSub(int32_t a, int32_t b){ return (int32_t)((uint32_t)a - (uint32_t)b); }
+static int32_t wrapMul(int32_t a, int32_t b){ return (int32_t)((uint32_t)a * (uint32_t)b); }
+
+
+// buffered stdout, flushed when the program ends
+static char outBuf[1 << 16];
+static size_t outLen = 0;
+
+static void flushOut(){
+    fwrite(outBuf, 1, outLen, stdout);
+    fflush(stdout);
+    outLen = 0;
+}
+
+static void writeOut(const char* s, size_t len){
+    if(outLen + len > sizeof(outBuf)){
+        flushOut();
+        if(len > sizeof(outBuf)){
+            fwrite(s, 1, len, stdout);
+            return;
+        }
+    }
+    memcpy(outBuf + outLen, s, len);
+    outLen += len;
+}
+
+static void writeInt(int32_t v){
+    char tmp[16];
+    char* p = tmp + sizeof(tmp);
+    uint32_t u = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+    do{
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while(u);
+    if(v < 0) *--p = '-';
+    writeOut(p, tmp + sizeof(tmp) - p);
+}
+
+static void writeBool(int32_t v){
+    if(v) writeOut("true", 4);
+    else writeOut("false", 5);
+}
+
+// buffered stdin of read, same token rules as __read_int/__read_bool of the JVM class
+static unsigned char inBuf[1 << 16];
+static size_t inPos = 0, inLen = 0;
+
+static int readByte(){
+    if(inPos == inLen){
+        flushOut(); // prompts are visible before blocking on input
+        inLen = fread(inBuf, 1, sizeof(inBuf), stdin);
+        inPos = 0;
+        if(inLen == 0) return -1;
+    }
+    return inBuf[inPos++];
+}
+
+static int32_t readInt(){
+    int c = readByte();
+    while(c >= 0 && c <= ' ') c = readByte();
+    if(c < 0) return 0;
+    bool negative = c == '-';
+    if(negative) c = readByte();
+    uint32_t value = 0;
+    while(c >= '0' && c <= '9'){
+        value = value * 10 + (c - '0');
+        c = readByte();
+    }
+    return negative ? (int32_t)(0u - value) : (int32_t)value;
+}
+
+static int32_t readBool(){
+    int c = readByte();
+    while(c >= 0 && c <= ' ') c = readByte();
+    int first = c;
+    while(c > ' ') c = readByte();
+    return first == 't';
+}
+
+
+
+VM::VM(){
+    this->className = "";
+    this->executed = 0;
+}
+
+bool VM::fail(string msg){
+    this->error = msg;
+    return false;
+}
+
+// "int example.counter" => index of global counter, -1 if not a field of this class
+int VM::globalIndex(string arg){
+    string field = arg.substr(arg.find(' ') + 1);
+    size_t dot = field.rfind('.');
+    if(field.substr(0, dot) != this->className) return -1;
+    string name = field.substr(dot + 1);
+    for(int i=0; i<(int)this->globalNames.size(); i++){
+        if(this->globalNames[i] == name) return i;
+    }
+    return -1;
+}
+
+bool VM::translate(JasmMethod& method, vector<pair<int, string>>& calls){
+    vector<JasmInsn>& body = method.body;
+    map<string, int> labelPos;
+    map<string, int> labelRefs;
+    vector<pair<int, string>> jumps; // code index, target label
+
+    for(JasmInsn& insn : body){
+        if(condIndex(insn.op) >= 0 || insn.op == "goto") labelRefs[insn.arg]++;
+    }
+
+    Method& m = this->methods.back();
+    int numLocals = max(1, m.numParams);
+
+    auto emit = [this](int op, int a, int b){ this->code.push_back({op, a, b}); };
+    auto isLabel = [&body](int i, string name){ return i < (int)body.size() && body[i].label == name; };
+    auto isOp = [&body](int i, string op){ return i < (int)body.size() && body[i].op == op; };
+
+    for(int i=0; i<(int)body.size(); i++){
+        JasmInsn& insn = body[i];
+        if(!insn.label.empty()){
+            labelPos[insn.label] = this->code.size();
+            continue;
+        }
+        string op = insn.op, arg = insn.arg;
+
+        /*
+         * compare pattern of exprDFS:
+         * isub / if<cond> L1 / iconst_0 / goto L2 / L1: / nop / iconst_1 / L2:
+         * => CMP<cond>, or BR<cond> when a ifeq/ifne follows
+         */
+        if(op == "isub" && i + 7 < (int)body.size() && condIndex(body[i + 1].op) >= 0 && isOp(i + 2, "iconst_0") && isOp(i + 3, "goto")
+           && isLabel(i + 4, body[i + 1].arg) && isOp(i + 5, "nop") && isOp(i + 6, "iconst_1") && isLabel(i + 7, body[i + 3].arg)
+           && labelRefs[body[i + 1].arg] == 1 && labelRefs[body[i + 3].arg] == 1){
+            int cond = condIndex(body[i + 1].op);
+            int next = i + 8;
+            while(isOp(next, "nop")) next++;
+            if(isOp(next, "ifeq") || isOp(next, "ifne")){
+                if(body[next].op == "ifeq") cond = negateCond(cond);
+                jumps.push_back({(int)this->code.size(), body[next].arg});
+                emit(OP_BRLT + cond, 0, 0);
+                i = next;
+            }
+            else{
+                emit(OP_CMPLT + cond, 0, 0);
+                i = i + 7;
+            }
+            continue;
+        }
+
+        if(op == "nop") continue;
+        if(op == "sipush" || op == "bipush") emit(OP_PUSH, atoi(arg.c_str()), 0);
+        else if(op == "iconst_m1") emit(OP_PUSH, -1, 0);
+        else if(op.rfind("iconst_", 0) == 0) emit(OP_PUSH, atoi(op.c_str() + 7), 0);
+        else if(op == "ldc"){
+            if(arg[0] == '\"'){
+                this->strings.push_back(arg.substr(1, arg.size() - 2));
+                emit(OP_PUSH, this->strings.size() - 1, 0);
+            }
+            else emit(OP_PUSH, atoi(arg.c_str()), 0);
+        }
+        else if(op == "iload" || op == "istore" || op == "iinc"){
+            int slot = atoi(arg.c_str());
+            numLocals = max(numLocals, slot + 1);
+            if(op == "iload") emit(OP_LOAD, slot, 0);
+            else if(op == "istore") emit(OP_STORE, slot, 0);
+            else emit(OP_INC, slot, atoi(arg.c_str() + arg.find(' ')));
+        }
+        else if(op == "getstatic" || op == "putstatic"){
+            if(arg == "java.io.PrintStream java.lang.System.out") continue; // receiver of print, not needed
+            int g = this->globalIndex(arg);
+            if(g < 0) return this->fail("unsupported field: " + arg);
+            emit(op == "getstatic" ? OP_GETG : OP_PUTG, g, 0);
+        }
+        else if(op == "iadd") emit(OP_ADD, 0, 0);
+        else if(op == "isub") emit(OP_SUB, 0, 0);
+        else if(op == "imul") emit(OP_MUL, 0, 0);
+        else if(op == "idiv") emit(OP_DIV, 0, 0);
+        else if(op == "irem") emit(OP_REM, 0, 0);
+        else if(op == "ineg") emit(OP_NEG, 0, 0);
+        else if(op == "iand") emit(OP_AND, 0, 0);
+        else if(op == "ior")  emit(OP_OR, 0, 0);
+        else if(op == "ixor") emit(OP_XOR, 0, 0);
+        else if(condIndex(op) >= 0 || op == "goto"){
+            jumps.push_back({(int)this->code.size(), arg});
+            emit(op == "goto" ? OP_GOTO : OP_IFLT + condIndex(op), 0, 0);
+        }
+        else if(op == "dup")  emit(OP_DUP, 0, 0);
+        else if(op == "pop")  emit(OP_POP, 0, 0);
+        else if(op == "swap") emit(OP_SWAP, 0, 0);
+        else if(op == "return")  emit(OP_RET, 0, 0);
+        else if(op == "ireturn") emit(OP_IRET, 0, 0);
+        else if(op == "invokestatic"){
+            string returnType, name;
+            vector<string> paramTypes;
+            parseSignature(arg, returnType, name, paramTypes);
+            size_t dot = name.rfind('.');
+            if(name.substr(0, dot) != this->className) return this->fail("unsupported call: " + arg);
+            if(name.substr(dot + 1) == "__read_int"){ emit(OP_READ_INT, 0, 0); continue; }
+            if(name.substr(dot + 1) == "__read_bool"){ emit(OP_READ_BOOL, 0, 0); continue; }
+            calls.push_back({(int)this->code.size(), name.substr(dot + 1)});
+            emit(OP_CALL, 0, 0);
+        }
+        else if(op == "invokevirtual"){
+            if(arg == "void java.io.PrintStream.print(int)") emit(OP_PRINT_INT, 0, 0);
+            else if(arg == "void java.io.PrintStream.print(boolean)") emit(OP_PRINT_BOOL, 0, 0);
+            else if(arg == "void java.io.PrintStream.print(java.lang.String)") emit(OP_PRINT_STR, 0, 0);
+            else if(arg == "void java.io.PrintStream.println(int)") emit(OP_PRINTLN_INT, 0, 0);
+            else if(arg == "void java.io.PrintStream.println(boolean)") emit(OP_PRINTLN_BOOL, 0, 0);
+            else if(arg == "void java.io.PrintStream.println(java.lang.String)") emit(OP_PRINTLN_STR, 0, 0);
+            else return this->fail("unsupported call: " + arg);
+        }
+        else return this->fail("unsupported instruction: " + op + " " + arg);
+    }
+    emit(OP_RET, 0, 0); // guard, never falls off the end
+
+    for(auto& jump : jumps){
+        if(labelPos.find(jump.second) == labelPos.end()) return this->fail("undefined label: " + jump.second);
+        this->code[jump.first].a = labelPos[jump.second];
+    }
+    m.numLocals = numLocals;
+    return true;
+}
+
+bool VM::load(string jasm){
+    JasmClass cls = parseJasm(jasm);
+    this->className = cls.name;
+    for(JasmField& field : cls.fields){
+        if(field.type != "int") return this->fail("unsupported field type: " + field.type);
+        this->globalNames.push_back(field.name);
+        this->globals.push_back(field.value);
+    }
+
+    vector<pair<int, string>> calls; // code index, method name
+    for(JasmMethod& method : cls.methods){
+        Method m;
+        m.name = method.name;
+        m.numParams = (method.name == "main") ? 0 : method.paramTypes.size();
+        m.returnsValue = method.returnType != "void";
+        m.entry = this->code.size();
+        this->methods.push_back(m);
+        if(!this->translate(method, calls)) return false;
+    }
+
+    for(auto& call : calls){
+        int index = -1;
+        for(int i=0; i<(int)this->methods.size(); i++){
+            if(this->methods[i].name == call.second) index = i;
+        }
+        if(index < 0) return this->fail("undefined method: " + call.second);
+        this->code[call.first].a = index;
+    }
+    return true;
+}
+
+
+int VM::run(bool countInsns){
+    static void* handlers[OP_COUNT] = {
+        &&op_push, &&op_load, &&op_store, &&op_inc, &&op_getg, &&op_putg,
+        &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_rem, &&op_neg, &&op_and, &&op_or, &&op_xor,
+        &&op_cmplt, &&op_cmpgt, &&op_cmple, &&op_cmpge, &&op_cmpeq, &&op_cmpne,
+        &&op_brlt, &&op_brgt, &&op_brle, &&op_brge, &&op_breq, &&op_brne,
+        &&op_iflt, &&op_ifgt, &&op_ifle, &&op_ifge, &&op_ifeq, &&op_ifne,
+        &&op_goto, &&op_dup, &&op_pop, &&op_swap,
+        &&op_call, &&op_ret, &&op_iret,
+        &&op_print_int, &&op_print_bool, &&op_print_str,
+        &&op_println_int, &&op_println_bool, &&op_println_str,
+        &&op_read_int, &&op_read_bool
+    };
+
+    // direct threaded code: handler address, operands
+    typedef struct Threaded{
+        void* handler;
+        int32_t a;
+        int32_t b;
+    } Threaded;
+    typedef struct Frame{
+        const Threaded* ret;
+        int32_t* locals;
+        int32_t* localsTop;     // locals of the next frame start here
+        int32_t* stackBase;     // operand stack of the caller ends here
+    } Frame;
+
+    int mainIndex = -1;
+    for(int i=0; i<(int)this->methods.size(); i++){
+        if(this->methods[i].name == "main") mainIndex = i;
+    }
+    if(mainIndex < 0){
+        fprintf(stderr, "no main method\n");
+        return 1;
+    }
+
+    vector<Threaded> threaded(this->code.size());
+    vector<Threaded> entries(this->methods.size());  // a: entry, b: numLocals
+    for(int i=0; i<(int)this->code.size(); i++){
+        threaded[i] = {handlers[this->code[i].op], this->code[i].a, this->code[i].b};
+    }
+    for(int i=0; i<(int)this->methods.size(); i++){
+        entries[i] = {nullptr, this->methods[i].entry, this->methods[i].numLocals};
+    }
+    // call operands: b = number of params
+    for(int i=0; i<(int)this->code.size(); i++){
+        if(this->code[i].op == OP_CALL) threaded[i].b = this->methods[this->code[i].a].numParams;
+    }
+    // counting: every instruction goes through op_count, which dispatches to the real handler
+    vector<void*> realHandlers(this->code.size());
+    for(int i=0; i<(int)this->code.size() && countInsns; i++){
+        realHandlers[i] = threaded[i].handler;
+        threaded[i].handler = &&op_count;
+    }
+    this->executed = 0;
+
+    vector<int32_t> stackMem(STACK_SIZE), localsMem(LOCALS_SIZE);
+    vector<Frame> frames(MAX_DEPTH);
+    int32_t* g = this->globals.data();
+    const Threaded* code = threaded.data();
+    const Threaded* ip;
+    int32_t* sp = stackMem.data();            // next free slot
+    int32_t* stackEnd = stackMem.data() + STACK_SIZE;
+    int32_t* locals = localsMem.data();
+    int32_t* localsEnd = localsMem.data() + LOCALS_SIZE;
+    Frame* fp = frames.data();
+    Frame* fpEnd = frames.data() + MAX_DEPTH;
+    int32_t a, b;
+
+    memset(locals, 0, sizeof(int32_t) * this->methods[mainIndex].numLocals);
+    *fp = {nullptr, locals, locals + this->methods[mainIndex].numLocals, sp};
+    ip = code + this->methods[mainIndex].entry;
+
+#define NEXT goto *ip->handler
+#define BRANCH(cond) if(cond) ip = code + ip->a; else ip++; NEXT
+
+    NEXT;
+
+op_count: this->executed++; goto *realHandlers[ip - code];
+
+op_push:  *sp++ = ip->a; ip++; NEXT;
+op_load:  *sp++ = fp->locals[ip->a]; ip++; NEXT;
+op_store: fp->locals[ip->a] = *--sp; ip++; NEXT;
+op_inc:   fp->locals[ip->a] = wrapAdd(fp->locals[ip->a], ip->b); ip++; NEXT;
+op_getg:  *sp++ = g[ip->a]; ip++; NEXT;
+op_putg:  g[ip->a] = *--sp; ip++; NEXT;
+
+op_add: sp--; sp[-1] = wrapAdd(sp[-1], sp[0]); ip++; NEXT;
+op_sub: sp--; sp[-1] = wrapSub(sp[-1], sp[0]); ip++; NEXT;
+op_mul: sp--; sp[-1] = wrapMul(sp[-1], sp[0]); ip++; NEXT;
+op_div:
+    sp--; a = sp[-1]; b = sp[0];
+    if(b == 0) goto div_zero;
+    sp[-1] = (b == -1) ? wrapSub(0, a) : a / b;
+    ip++; NEXT;
+op_rem:
+    sp--; a = sp[-1]; b = sp[0];
+    if(b == 0) goto div_zero;
+    sp[-1] = (b == -1) ? 0 : a % b;
+    ip++; NEXT;
+op_neg: sp[-1] = wrapSub(0, sp[-1]); ip++; NEXT;
+op_and: sp--; sp[-1] &= sp[0]; ip++; NEXT;
+op_or:  sp--; sp[-1] |= sp[0]; ip++; NEXT;
+op_xor: sp--; sp[-1] ^= sp[0]; ip++; NEXT;
+
+op_cmplt: sp--; sp[-1] = wrapSub(sp[-1], sp[0]) <  0; ip++; NEXT;
+op_cmpgt: sp--; sp[-1] = wrapSub(sp[-1], sp[0]) >  0; ip++; NEXT;
+op_cmple: sp--; sp[-1] = wrapSub(sp[-1], sp[0]) <= 0; ip++; NEXT;
+op_cmpge: sp--; sp[-1] = wrapSub(sp[-1], sp[0]) >= 0; ip++; NEXT;
+op_cmpeq: sp--; sp[-1] = sp[-1] == sp[0]; ip++; NEXT;
+op_cmpne: sp--; sp[-1] = sp[-1] != sp[0]; ip++; NEXT;
+
+op_brlt: sp -= 2; BRANCH(wrapSub(sp[0], sp[1]) <  0);
+op_brgt: sp -= 2; BRANCH(wrapSub(sp[0], sp[1]) >  0);
+op_brle: sp -= 2; BRANCH(wrapSub(sp[0], sp[1]) <= 0);
+op_brge: sp -= 2; BRANCH(wrapSub(sp[0], sp[1]) >= 0);
+op_breq: sp -= 2; BRANCH(sp[0] == sp[1]);
+op_brne: sp -= 2; BRANCH(sp[0] != sp[1]);
+
+op_iflt: sp--; BRANCH(*sp <  0);
+op_ifgt: sp--; BRANCH(*sp >  0);
+op_ifle: sp--; BRANCH(*sp <= 0);
+op_ifge: sp--; BRANCH(*sp >= 0);
+op_ifeq: sp--; BRANCH(*sp == 0);
+op_ifne: sp--; BRANCH(*sp != 0);
+
+op_goto: ip = code + ip->a; NEXT;
+op_dup:  *sp = sp[-1]; sp++; ip++; NEXT;
+op_pop:  sp--; ip++; NEXT;
+op_swap: a = sp[-1]; sp[-1] = sp[-2]; sp[-2] = a; ip++; NEXT;
+
+op_call:{
+    const Threaded& entry = entries[ip->a];
+    int numParams = ip->b;
+    // locals of the callee start after the locals of the caller
+    int32_t* newLocals = fp->localsTop;
+    if(fp + 1 == fpEnd || newLocals + entry.b > localsEnd || sp + 4096 > stackEnd) goto stack_overflow;
+    sp -= numParams;
+    memcpy(newLocals, sp, sizeof(int32_t) * numParams);
+    memset(newLocals + numParams, 0, sizeof(int32_t) * (entry.b - numParams));
+    fp++;
+    *fp = {ip + 1, newLocals, newLocals + entry.b, sp};
+    ip = code + entry.a;
+    NEXT;
+}
+op_ret:
+    sp = fp->stackBase;
+    ip = fp->ret;
+    if(fp == frames.data()) goto done;
+    fp--;
+    NEXT;
+op_iret:
+    a = sp[-1];
+    sp = fp->stackBase;
+    *sp++ = a;
+    ip = fp->ret;
+    fp--;
+    NEXT;
+
+op_print_int:    writeInt(*--sp); ip++; NEXT;
+op_print_bool:   writeBool(*--sp); ip++; NEXT;
+op_print_str:    sp--; writeOut(this->strings[*sp].data(), this->strings[*sp].size()); ip++; NEXT;
+op_println_int:  writeInt(*--sp); writeOut("\n", 1); ip++; NEXT;
+op_println_bool: writeBool(*--sp); writeOut("\n", 1); ip++; NEXT;
+op_println_str:  sp--; writeOut(this->strings[*sp].data(), this->strings[*sp].size()); writeOut("\n", 1); ip++; NEXT;
+op_read_int:     *sp++ = readInt(); ip++; NEXT;
+op_read_bool:    *sp++ = readBool(); ip++; NEXT;
+
+div_zero:
+    flushOut();
+    fprintf(stderr, "Exception in thread \"main\" java.lang.ArithmeticException: / by zero\n");
+    return 1;
+
+stack_overflow:
+    flushOut();
+    fprintf(stderr, "Exception in thread \"main\" java.lang.StackOverflowError\n");
+    return 1;
+
+done:
+    flushOut();
+    return 0;
+#undef NEXT
+#undef BRANCH
+}
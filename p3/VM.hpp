@@ -0,0 +1,52 @@
+#ifndef VM_HPP
+#define VM_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Jasm.hpp"
+
+using namespace std;
+
+/*
+ * VM: in-process interpreter used by --run
+ * the generated jasm is translated into a compact stack bytecode
+ * (labels resolved, compare/branch sequences fused, print calls as opcodes)
+ * and executed with computed-goto dispatch, output matches the JVM
+ */
+class VM{
+public:
+    VM();
+    bool load(string jasm);     // false on unsupported jasm, see error
+    int run(bool countInsns = false);   // execute main, return exit status
+    string error;
+    long long executed;         // number of executed instructions, counted by run(true)
+
+private:
+    typedef struct Insn{
+        int op;
+        int a;
+        int b;
+    } Insn;
+
+    typedef struct Method{
+        string name;
+        int numParams;
+        int numLocals;
+        bool returnsValue;
+        int entry;              // index of the first instruction in code
+    } Method;
+
+    string className;
+    vector<Insn> code;
+    vector<Method> methods;
+    vector<string> strings;     // ldc pool, strings are pushed as pool index
+    vector<string> globalNames;
+    vector<int32_t> globals;
+
+    bool translate(JasmMethod& method, vector<pair<int, string>>& calls);
+    int globalIndex(string arg);
+    bool fail(string msg);
+};
+
+#endif // VM_HPP
@@ -0,0 +1,683 @@
+#include "X86Backend.hpp"
+#include "Jasm.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// operand stack slot k (k < 6) lives in STACK_REGS[k], rax/rcx/rdx are scratch
+static const vector<string> STACK_REGS  = {"r10", "r11", "r8", "r9", "rsi", "rdi"};
+// locals are allocated to callee-saved registers
+static const vector<string> LOCAL_REGS  = {"rbx", "r12", "r13", "r14", "r15"};
+static const vector<string> ARG_REGS    = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+
+
+// runtime: entry point, buffered stdout and stdin, and the exception exit of division by zero
+static const char* RUNTIME = R"(
+# ---------------- sD runtime ----------------
+    .text
+    .globl _start
+_start:
+    xor ebp, ebp
+    and rsp, -16
+    call sd_main
+    call sd_flush
+    xor edi, edi
+    mov eax, 60
+    syscall
+
+# sd_write_all(edi: fd, rsi: buffer, rdx: length)
+sd_write_all:
+    test rdx, rdx
+    jz 2f
+1:
+    mov eax, 1
+    syscall
+    test rax, rax
+    js 2f
+    add rsi, rax
+    sub rdx, rax
+    jnz 1b
+2:
+    ret
+
+sd_flush:
+    mov rdx, qword ptr [rip + sd_out_len]
+    lea rsi, [rip + sd_out_buf]
+    mov edi, 1
+    mov qword ptr [rip + sd_out_len], 0
+    jmp sd_write_all
+
+# sd_write(rdi: buffer, rsi: length), append to the output buffer
+sd_write:
+    mov rax, qword ptr [rip + sd_out_len]
+    lea rdx, [rax + rsi]
+    cmp rdx, 65536
+    jbe 1f
+    push rdi
+    push rsi
+    call sd_flush
+    pop rsi
+    pop rdi
+    xor eax, eax
+    cmp rsi, 65536
+    jbe 1f
+    mov rdx, rsi
+    mov rsi, rdi
+    mov edi, 1
+    jmp sd_write_all
+1:
+    lea rdx, [rip + sd_out_buf]
+    add rdx, rax
+    add rax, rsi
+    mov qword ptr [rip + sd_out_len], rax
+    mov rcx, rsi
+    mov rsi, rdi
+    mov rdi, rdx
+    rep movsb
+    ret
+
+sd_newline:
+    lea rdi, [rip + sd_str_newline]
+    mov esi, 1
+    jmp sd_write
+
+# sd_print_str(rdi: NUL terminated string)
+sd_print_str:
+    mov rax, rdi
+1:
+    cmp byte ptr [rax], 0
+    je 2f
+    inc rax
+    jmp 1b
+2:
+    sub rax, rdi
+    mov rsi, rax
+    jmp sd_write
+
+# sd_print_int(edi)
+sd_print_int:
+    sub rsp, 24
+    mov eax, edi
+    mov r8d, edi
+    lea rsi, [rsp + 24]
+    mov ecx, 10
+    test eax, eax
+    jns 1f
+    neg eax
+1:
+    xor edx, edx
+    div ecx
+    add dl, 48
+    dec rsi
+    mov byte ptr [rsi], dl
+    test eax, eax
+    jnz 1b
+    test r8d, r8d
+    jns 2f
+    dec rsi
+    mov byte ptr [rsi], 45
+2:
+    lea rdx, [rsp + 24]
+    sub rdx, rsi
+    mov rdi, rsi
+    mov rsi, rdx
+    call sd_write
+    add rsp, 24
+    ret
+
+# sd_print_bool(edi)
+sd_print_bool:
+    test edi, edi
+    jz 1f
+    lea rdi, [rip + sd_str_true]
+    mov esi, 4
+    jmp sd_write
+1:
+    lea rdi, [rip + sd_str_false]
+    mov esi, 5
+    jmp sd_write
+
+sd_println_str:
+    sub rsp, 8
+    call sd_print_str
+    add rsp, 8
+    jmp sd_newline
+
+sd_println_int:
+    sub rsp, 8
+    call sd_print_int
+    add rsp, 8
+    jmp sd_newline
+
+sd_println_bool:
+    sub rsp, 8
+    call sd_print_bool
+    add rsp, 8
+    jmp sd_newline
+
+# sd_read_byte: eax = next byte of stdin, -1 at the end of input, keeps r8 and r9
+sd_read_byte:
+    mov rax, qword ptr [rip + sd_in_pos]
+    cmp rax, qword ptr [rip + sd_in_len]
+    jb 1f
+    call sd_flush
+    xor eax, eax
+    xor edi, edi
+    lea rsi, [rip + sd_in_buf]
+    mov edx, 65536
+    syscall
+    test rax, rax
+    jle 2f
+    mov qword ptr [rip + sd_in_len], rax
+    xor eax, eax
+1:
+    lea rdx, [rip + sd_in_buf]
+    movzx ecx, byte ptr [rdx + rax]
+    inc rax
+    mov qword ptr [rip + sd_in_pos], rax
+    mov eax, ecx
+    ret
+2:
+    mov qword ptr [rip + sd_in_len], 0
+    mov qword ptr [rip + sd_in_pos], 0
+    mov eax, -1
+    ret
+
+# __read_int of the class: skip whitespace, optional '-' and digits, 0 at the end of input
+sd___read_int:
+    xor r8d, r8d
+    xor r9d, r9d
+1:
+    call sd_read_byte
+    test eax, eax
+    js 4f
+    cmp eax, 32
+    jle 1b
+    cmp eax, 45
+    jne 2f
+    mov r9d, 1
+    call sd_read_byte
+2:
+    sub eax, 48
+    cmp eax, 9
+    ja 3f
+    imul r8d, r8d, 10
+    add r8d, eax
+    call sd_read_byte
+    jmp 2b
+3:
+    mov eax, r8d
+    test r9d, r9d
+    jz 5f
+    neg eax
+5:
+    ret
+4:
+    xor eax, eax
+    ret
+
+# __read_bool of the class: true if the token starts with 't'
+sd___read_bool:
+1:
+    call sd_read_byte
+    test eax, eax
+    js 3f
+    cmp eax, 32
+    jle 1b
+    mov r8d, eax
+2:
+    call sd_read_byte
+    cmp eax, 32
+    jg 2b
+    xor eax, eax
+    cmp r8d, 116
+    sete al
+    ret
+3:
+    xor eax, eax
+    ret
+
+sd_div_zero:
+    call sd_flush
+    mov edi, 2
+    lea rsi, [rip + sd_str_div_zero]
+    mov edx, offset sd_str_div_zero_len
+    call sd_write_all
+    mov edi, 1
+    mov eax, 60
+    syscall
+
+    .data
+sd_out_len:
+    .quad 0
+sd_in_pos:
+    .quad 0
+sd_in_len:
+    .quad 0
+    .bss
+sd_out_buf:
+    .skip 65536
+sd_in_buf:
+    .skip 65536
+    .section .rodata
+sd_str_true:
+    .ascii "true"
+sd_str_false:
+    .ascii "false"
+sd_str_newline:
+    .ascii "\n"
+sd_str_div_zero:
+    .ascii "Exception in thread \"main\" java.lang.ArithmeticException: / by zero\n"
+    .set sd_str_div_zero_len, . - sd_str_div_zero
+)";
+
+
+static string reg32(string r){
+    if(r == "rax" || r == "rbx" || r == "rcx" || r == "rdx") return "e" + r.substr(1);
+    if(r == "rsi" || r == "rdi") return "e" + r.substr(1);
+    return r + "d"; // r8 - r15
+}
+
+static int condIndex(string op){
+    static const vector<string> conds = {"iflt", "ifgt", "ifle", "ifge", "ifeq", "ifne"};
+    for(int i=0; i<(int)conds.size(); i++){
+        if(conds[i] == op) return i;
+    }
+    return -1;
+}
+
+static string escapeString(string s){
+    string result = "";
+    for(char c : s){
+        if(c == '\"' || c == '\\') result += string("\\") + c;
+        else if(c == '\n') result += "\\n";
+        else if(c == '\t') result += "\\t";
+        else result += c;
+    }
+    return result;
+}
+
+static bool isJump(JasmInsn& insn){
+    return insn.op == "goto" || condIndex(insn.op) >= 0;
+}
+
+// stack effect, false if the instruction is not supported
+static bool stackEffect(JasmInsn& insn, int& pop, int& push){
+    string op = insn.op;
+    pop = push = 0;
+    if(op == "nop" || op == "goto" || op == "return" || op == "iinc" || op == "ineg" || op == "swap") return true;
+    if(op == "sipush" || op == "bipush" || op == "ldc" || op == "iload" || op.rfind("iconst_", 0) == 0){ push = 1; return true; }
+    if(op == "istore" || op == "pop" || op == "ireturn" || op == "putstatic" || condIndex(op) >= 0){ pop = 1; return true; }
+    if(op == "iadd" || op == "isub" || op == "imul" || op == "idiv" || op == "irem" || op == "iand" || op == "ior" || op == "ixor"){ pop = 2; push = 1; return true; }
+    if(op == "dup"){ pop = 1; push = 2; return true; }
+    if(op == "getstatic"){
+        push = (insn.arg == "java.io.PrintStream java.lang.System.out") ? 0 : 1; // print receiver is not materialized
+        return true;
+    }
+    if(op == "invokestatic"){
+        string returnType, name;
+        vector<string> paramTypes;
+        parseSignature(insn.arg, returnType, name, paramTypes);
+        pop = paramTypes.size();
+        push = returnType != "void";
+        return true;
+    }
+    if(op == "invokevirtual" && insn.arg.rfind("void java.io.PrintStream.print", 0) == 0){ pop = 1; return true; }
+    return false;
+}
+
+
+
+X86Backend::X86Backend(){
+    this->className = "unknown";
+    this->stringCounter = 0;
+}
+
+bool X86Backend::fail(string msg){
+    this->error = msg;
+    return false;
+}
+
+string X86Backend::dump(){
+    string asmText = "    .intel_syntax noprefix\n" + this->text + "\n    .data\n" + this->data
+                   + "\n    .section .rodata\n" + this->rodata + RUNTIME;
+    ofstream output(this->className + ".s");
+    output << asmText;
+    output.close();
+    return asmText;
+}
+
+bool X86Backend::generate(string jasm){
+    JasmClass cls = parseJasm(jasm);
+    this->className = cls.name;
+    for(JasmField& field : cls.fields){
+        if(field.type != "int") return this->fail("unsupported field type: " + field.type);
+        this->data += "sd_g_" + field.name + ":\n    .long " + to_string(field.value) + "\n";
+    }
+    for(JasmMethod& method : cls.methods){
+        if(!this->generateMethod(method)) return false;
+    }
+    return true;
+}
+
+
+// operand stack depth before every instruction, -1 if unreachable
+bool X86Backend::computeDepth(vector<JasmInsn>& body, map<string, int>& labelPos, vector<int>& depth, int& maxDepth){
+    depth.assign(body.size() + 1, -1);
+    maxDepth = 0;
+    vector<int> worklist = {0};
+    depth[0] = 0;
+    while(!worklist.empty()){
+        int i = worklist.back(); worklist.pop_back();
+        if(i >= (int)body.size()) continue;
+        int pop, push;
+        if(!body[i].label.empty()) pop = push = 0;
+        else if(!stackEffect(body[i], pop, push)) return this->fail("unsupported instruction: " + body[i].op + " " + body[i].arg);
+        if(depth[i] < pop) return this->fail("operand stack underflow at " + body[i].op);
+        int d = depth[i] - pop + push;
+        maxDepth = max(maxDepth, d);
+
+        vector<int> next;
+        if(isJump(body[i])){
+            if(labelPos.find(body[i].arg) == labelPos.end()) return this->fail("undefined label: " + body[i].arg);
+            next.push_back(labelPos[body[i].arg]);
+        }
+        if(body[i].op != "goto" && body[i].op != "return" && body[i].op != "ireturn") next.push_back(i + 1);
+        for(int n : next){
+            if(depth[n] == -1){
+                depth[n] = d;
+                worklist.push_back(n);
+            }
+            else if(depth[n] != d) return this->fail("inconsistent operand stack at " + body[i].arg);
+        }
+    }
+    return true;
+}
+
+
+/*
+ * linear scan register allocation of the locals
+ * interval of a slot: first to last reference, extended over every loop it overlaps,
+ * locals that do not get a callee-saved register are spilled to the frame
+ */
+void X86Backend::allocateLocals(vector<JasmInsn>& body, map<string, int>& labelPos, int numParams,
+                                map<int, Location>& locals, vector<string>& usedRegs, int& numSpills){
+    map<int, pair<int, int>> interval;
+    for(int k=0; k<numParams; k++) interval[k] = {0, 0};
+    for(int i=0; i<(int)body.size(); i++){
+        if(body[i].op != "iload" && body[i].op != "istore" && body[i].op != "iinc") continue;
+        int slot = atoi(body[i].arg.c_str());
+        if(interval.find(slot) == interval.end()) interval[slot] = {i, i};
+        interval[slot].first = min(interval[slot].first, i);
+        interval[slot].second = max(interval[slot].second, i);
+    }
+
+    vector<pair<int, int>> loops;
+    for(int i=0; i<(int)body.size(); i++){
+        if(isJump(body[i]) && labelPos[body[i].arg] <= i) loops.push_back({labelPos[body[i].arg], i});
+    }
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(auto& loop : loops){
+            for(auto& it : interval){
+                pair<int, int>& range = it.second;
+                if(range.first > loop.second || range.second < loop.first) continue;
+                if(range.first > loop.first){ range.first = loop.first; changed = true; }
+                if(range.second < loop.second){ range.second = loop.second; changed = true; }
+            }
+        }
+    }
+
+    vector<int> order;
+    for(auto& it : interval) order.push_back(it.first);
+    sort(order.begin(), order.end(), [&interval](int a, int b){ return interval[a].first < interval[b].first; });
+
+    vector<string> freeRegs(LOCAL_REGS.rbegin(), LOCAL_REGS.rend());
+    vector<int> active; // slots holding a register
+    set<string> used;
+    numSpills = 0;
+    for(int slot : order){
+        int start = interval[slot].first;
+        // expire
+        for(int i=0; i<(int)active.size(); ){
+            if(interval[active[i]].second < start){
+                freeRegs.push_back(locals[active[i]].reg);
+                active.erase(active.begin() + i);
+            }
+            else i++;
+        }
+        if(!freeRegs.empty()){
+            locals[slot] = {freeRegs.back(), 0};
+            freeRegs.pop_back();
+            active.push_back(slot);
+        }
+        else{
+            // spill the interval that ends last
+            int victim = slot;
+            for(int a : active){
+                if(interval[a].second > interval[victim].second) victim = a;
+            }
+            if(victim != slot){
+                locals[slot] = {locals[victim].reg, 0};
+                active.erase(find(active.begin(), active.end(), victim));
+                active.push_back(slot);
+            }
+            locals[victim] = {"", ++numSpills};
+        }
+        if(!locals[slot].reg.empty()) used.insert(locals[slot].reg);
+    }
+    for(const string& reg : LOCAL_REGS){
+        if(used.count(reg)) usedRegs.push_back(reg);
+    }
+}
+
+
+bool X86Backend::generateMethod(JasmMethod& method){
+    vector<JasmInsn>& body = method.body;
+    string fn = method.name;
+    int numParams = (fn == "main") ? 0 : method.paramTypes.size();
+
+    map<string, int> labelPos;
+    for(int i=0; i<(int)body.size(); i++){
+        if(!body[i].label.empty()) labelPos[body[i].label] = i;
+    }
+    vector<int> depth;
+    int maxDepth;
+    if(!this->computeDepth(body, labelPos, depth, maxDepth)) return false;
+
+    map<int, Location> locals;
+    vector<string> usedRegs;
+    int numSpills;
+    this->allocateLocals(body, labelPos, numParams, locals, usedRegs, numSpills);
+
+    // frame: rbp, callee-saved registers, spilled locals, spilled stack slots
+    int saved = usedRegs.size();
+    for(auto& it : locals){
+        if(it.second.reg.empty()) it.second.offset = 8 * saved + 8 * it.second.offset;
+    }
+    int stackSpills = max(0, maxDepth - (int)STACK_REGS.size());
+    int frameSize = 8 * (numSpills + stackSpills);
+    if((8 * saved + frameSize) % 16 != 0) frameSize += 8;
+
+    auto slot = [&](int k) -> Location{
+        if(k < (int)STACK_REGS.size()) return {STACK_REGS[k], 0};
+        return {"", 8 * saved + 8 * numSpills + 8 * (k - (int)STACK_REGS.size() + 1)};
+    };
+    auto op64 = [](Location l){ return l.reg.empty() ? "qword ptr [rbp - " + to_string(l.offset) + "]" : l.reg; };
+    auto op32 = [](Location l){ return l.reg.empty() ? "dword ptr [rbp - " + to_string(l.offset) + "]" : reg32(l.reg); };
+    auto isMem = [](Location l){ return l.reg.empty(); };
+    auto label = [&fn](string name){ return ".L_" + fn + "_" + name; };
+
+    string out = "";
+    auto emit = [&out](string line){ out += "    " + line + "\n"; };
+    auto move64 = [&](Location dst, Location src){
+        if(!isMem(dst) && !isMem(src) && dst.reg == src.reg) return;
+        if(isMem(dst) && isMem(src)){
+            emit("mov rax, " + op64(src));
+            emit("mov " + op64(dst) + ", rax");
+        }
+        else emit("mov " + op64(dst) + ", " + op64(src));
+    };
+    // call with n arguments on top of the operand stack at depth d
+    auto emitCall = [&](string target, int d, int n, bool returnsValue){
+        vector<string> live;
+        for(int k=0; k<d-n && k<(int)STACK_REGS.size(); k++) live.push_back(STACK_REGS[k]);
+        int stackArgs = max(0, n - (int)ARG_REGS.size());
+        bool pad = (live.size() + stackArgs) % 2 == 1;
+        if(pad) emit("sub rsp, 8");
+        for(string& reg : live) emit("push " + reg);
+        for(int k=n-1; k>=0; k--) emit("push " + op64(slot(d - n + k)));
+        for(int k=0; k<n && k<(int)ARG_REGS.size(); k++) emit("pop " + ARG_REGS[k]);
+        emit("call " + target);
+        if(stackArgs) emit("add rsp, " + to_string(8 * stackArgs));
+        for(int k=live.size()-1; k>=0; k--) emit("pop " + live[k]);
+        if(pad) emit("add rsp, 8");
+        if(returnsValue) emit("mov " + op64(slot(d - n)) + ", rax");
+    };
+
+    out += "\n    .globl sd_" + fn + "\nsd_" + fn + ":\n";
+    emit("push rbp");
+    emit("mov rbp, rsp");
+    for(string& reg : usedRegs) emit("push " + reg);
+    if(frameSize) emit("sub rsp, " + to_string(frameSize));
+    for(int k=0; k<numParams; k++){
+        if(locals.find(k) == locals.end()) continue;
+        if(k < (int)ARG_REGS.size()) emit("mov " + op64(locals[k]) + ", " + ARG_REGS[k]);
+        else{
+            emit("mov rax, qword ptr [rbp + " + to_string(16 + 8 * (k - (int)ARG_REGS.size())) + "]");
+            emit("mov " + op64(locals[k]) + ", rax");
+        }
+    }
+
+    int localLabel = 0;
+    for(int i=0; i<(int)body.size(); i++){
+        JasmInsn& insn = body[i];
+        if(!insn.label.empty()){
+            out += label(insn.label) + ":\n";
+            continue;
+        }
+        int d = depth[i];
+        if(d < 0) continue; // unreachable
+        string op = insn.op, arg = insn.arg;
+
+        if(op == "nop") continue;
+        else if(op == "sipush" || op == "bipush") emit("mov " + op32(slot(d)) + ", " + to_string(atoi(arg.c_str())));
+        else if(op == "iconst_m1") emit("mov " + op32(slot(d)) + ", -1");
+        else if(op.rfind("iconst_", 0) == 0) emit("mov " + op32(slot(d)) + ", " + op.substr(7));
+        else if(op == "ldc"){
+            if(arg[0] == '\"'){
+                string name = ".Lstr_" + to_string(this->stringCounter++);
+                this->rodata += name + ":\n    .asciz \"" + escapeString(arg.substr(1, arg.size() - 2)) + "\"\n";
+                emit("lea rax, [rip + " + name + "]");
+                emit("mov " + op64(slot(d)) + ", rax");
+            }
+            else emit("mov " + op32(slot(d)) + ", " + to_string(atoi(arg.c_str())));
+        }
+        else if(op == "iload") move64(slot(d), locals[atoi(arg.c_str())]);
+        else if(op == "istore") move64(locals[atoi(arg.c_str())], slot(d - 1));
+        else if(op == "iinc"){
+            int k = atoi(arg.c_str() + arg.find(' '));
+            emit("add " + op32(locals[atoi(arg.c_str())]) + ", " + to_string(k));
+        }
+        else if(op == "getstatic" || op == "putstatic"){
+            if(arg == "java.io.PrintStream java.lang.System.out") continue;
+            string field = arg.substr(arg.find(' ') + 1);
+            size_t dot = field.rfind('.');
+            if(field.substr(0, dot) != this->className) return this->fail("unsupported field: " + arg);
+            string mem = "dword ptr [rip + sd_g_" + field.substr(dot + 1) + "]";
+            Location s = slot(op == "getstatic" ? d : d - 1);
+            if(op == "getstatic"){
+                if(isMem(s)){ emit("mov eax, " + mem); emit("mov " + op32(s) + ", eax"); }
+                else emit("mov " + op32(s) + ", " + mem);
+            }
+            else{
+                if(isMem(s)){ emit("mov eax, " + op32(s)); emit("mov " + mem + ", eax"); }
+                else emit("mov " + mem + ", " + op32(s));
+            }
+        }
+        else if(op == "iadd" || op == "isub" || op == "iand" || op == "ior" || op == "ixor" || op == "imul"){
+            static const map<string, string> names = {{"iadd", "add"}, {"isub", "sub"}, {"iand", "and"}, {"ior", "or"}, {"ixor", "xor"}, {"imul", "imul"}};
+            string name = names.at(op);
+            Location a = slot(d - 2), b = slot(d - 1);
+            if(!isMem(a)) emit(name + " " + op32(a) + ", " + op32(b));
+            else if(!isMem(b) && name != "imul") emit(name + " " + op32(a) + ", " + op32(b));
+            else{
+                emit("mov eax, " + op32(a));
+                emit(name + " eax, " + op32(b));
+                emit("mov " + op32(a) + ", eax");
+            }
+        }
+        else if(op == "idiv" || op == "irem"){
+            // JVM semantics: / by zero throws, MIN_VALUE / -1 does not trap
+            Location a = slot(d - 2), b = slot(d - 1);
+            string Ldiv = ".L_" + fn + "_div" + to_string(localLabel), Lend = ".L_" + fn + "_divend" + to_string(localLabel);
+            localLabel++;
+            emit("mov ecx, " + op32(b));
+            emit("test ecx, ecx");
+            emit("jz sd_div_zero");
+            emit("mov eax, " + op32(a));
+            emit("cmp ecx, -1");
+            emit("jne " + Ldiv);
+            emit("neg eax");
+            emit("xor edx, edx");
+            emit("jmp " + Lend);
+            out += Ldiv + ":\n";
+            emit("cdq");
+            emit("idiv ecx");
+            out += Lend + ":\n";
+            emit("mov " + op32(a) + ", " + (op == "idiv" ? "eax" : "edx"));
+        }
+        else if(op == "ineg") emit("neg " + op32(slot(d - 1)));
+        else if(condIndex(op) >= 0){
+            static const vector<string> jcc = {"jl", "jg", "jle", "jge", "je", "jne"};
+            emit("cmp " + op32(slot(d - 1)) + ", 0");
+            emit(jcc[condIndex(op)] + " " + label(arg));
+        }
+        else if(op == "goto") emit("jmp " + label(arg));
+        else if(op == "dup") move64(slot(d), slot(d - 1));
+        else if(op == "pop") continue;
+        else if(op == "swap"){
+            emit("mov rcx, " + op64(slot(d - 1)));
+            move64(slot(d - 1), slot(d - 2));
+            emit("mov " + op64(slot(d - 2)) + ", rcx");
+        }
+        else if(op == "return") emit("jmp " + label("return"));
+        else if(op == "ireturn"){
+            emit("mov rax, " + op64(slot(d - 1)));
+            emit("jmp " + label("return"));
+        }
+        else if(op == "invokestatic"){
+            string returnType, name;
+            vector<string> paramTypes;
+            parseSignature(arg, returnType, name, paramTypes);
+            size_t dot = name.rfind('.');
+            if(name.substr(0, dot) != this->className) return this->fail("unsupported call: " + arg);
+            emitCall("sd_" + name.substr(dot + 1), d, paramTypes.size(), returnType != "void");
+        }
+        else if(op == "invokevirtual"){
+            string kind = arg.substr(arg.find("PrintStream.") + 12);
+            string target = kind.rfind("println", 0) == 0 ? "sd_println_" : "sd_print_";
+            if(kind.find("(int)") != string::npos) target += "int";
+            else if(kind.find("(boolean)") != string::npos) target += "bool";
+            else target += "str";
+            emitCall(target, d, 1, false);
+        }
+        else return this->fail("unsupported instruction: " + op + " " + arg);
+    }
+
+    out += label("return") + ":\n";
+    emit("lea rsp, [rbp - " + to_string(8 * saved) + "]");
+    for(int k=usedRegs.size()-1; k>=0; k--) emit("pop " + usedRegs[k]);
+    emit("pop rbp");
+    emit("ret");
+
+    this->text += out;
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef X86_BACKEND_HPP
+#define X86_BACKEND_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include "Jasm.hpp"
+
+using namespace std;
+
+/*
+ * X86Backend: -target=x86_64
+ * lower the generated jasm into GNU assembler for Linux x86-64 (System V ABI)
+ * - operand stack slot k lives in a fixed caller-saved register, deeper slots in the frame
+ * - locals are assigned to callee-saved registers by linear scan, the rest are spilled
+ * - a tiny runtime (_start, buffered print, exit) is appended, no libc is needed
+ * build: as <class>.s -o <class>.o && ld <class>.o -o <class>
+ */
+class X86Backend{
+public:
+    X86Backend();
+    bool generate(string jasm);     // false on unsupported jasm, see error
+    string dump();                  // write <class>.s
+    string error;
+
+private:
+    // location of a value, register or frame offset (rbp - offset)
+    typedef struct Location{
+        string reg;     // 64-bit register name, empty if in memory
+        int offset;
+    } Location;
+
+    string className;
+    string text;        // .text of all methods
+    string data;        // .data of globals
+    string rodata;      // string literals
+    int stringCounter;
+
+    bool generateMethod(JasmMethod& method);
+    bool computeDepth(vector<JasmInsn>& body, map<string, int>& labelPos, vector<int>& depth, int& maxDepth);
+    void allocateLocals(vector<JasmInsn>& body, map<string, int>& labelPos, int numParams,
+                        map<int, Location>& locals, vector<string>& usedRegs, int& numSpills);
+    bool fail(string msg);
+};
+
+#endif // X86_BACKEND_HPP
@@ -0,0 +1,23 @@
+# executed VM instructions without and with an optimization flag
+# usage (in p3): bash bench/count_bench.sh <flag> [sD files], default bench/*.sd
+# e.g. bash bench/count_bench.sh -fcse
+flag=${1:?usage: bash bench/count_bench.sh <flag> [sD files]}
+shift
+files=("$@")
+if [ ${#files[@]} -eq 0 ]; then
+    files=(bench/*.sd)
+fi
+
+count(){
+    ./parser $1 --run --count "$2" 2>&1 > /dev/null | awk '/executed instructions/ {print $3}'
+}
+
+printf "%-20s %14s %18s %8s %8s\n" "program" "baseline" "$flag" "change" "output"
+for file in "${files[@]}"; do
+    name=$(basename "$file" .sd)
+    base=$(count "" "$file")
+    opt=$(count "$flag" "$file")
+    if cmp -s <(./parser --run "$file") <(./parser $flag --run "$file"); then same="same"; else same="DIFF"; fi
+    change=$(awk -v a="$base" -v b="$opt" 'BEGIN { printf "%.1f%%", (b - a) * 100.0 / a }')
+    printf "%-20s %14s %18s %8s %8s\n" "$name" "$base" "$opt" "$change" "$same"
+done
@@ -0,0 +1,47 @@
+# build time of a generated 200-module project, separate compilation (extern + .sdi) and one big file
+# usage (in p3): bash bench/module_bench.sh [number of modules], default 200
+N=${1:-200}
+FUNCS=20
+PARSER=$(pwd)/parser
+TIMEFORMAT=%R
+dir=$(mktemp -d)
+
+# module k imports module k-1, every function calls into the previous module
+gen_module(){
+    k=$1
+    if [ "$k" -gt 0 ]; then echo "extern mod$((k - 1));"; fi
+    echo "int g$k = $k;"
+    for f in $(seq 0 $((FUNCS - 1))); do
+        echo "int f${k}_$f(int x){"
+        echo "    int i, s = 0;"
+        echo "    for(i = 0; i < x; i = i + 1) s = s + i * $f;"
+        if [ "$k" -gt 0 ]; then echo "    s = s + f$((k - 1))_$f(x) + g$((k - 1));"; fi
+        echo "    return s;"
+        echo "}"
+    done
+}
+
+for k in $(seq 0 $((N - 1))); do
+    { gen_module "$k"; echo "void main(){ println f${k}_0(3); }"; } > "$dir/mod$k.sd"
+    gen_module "$k" | grep -v "^extern" >> "$dir/all.sd"
+done
+echo "void main(){ println f$((N - 1))_0(3); }" >> "$dir/all.sd"
+
+cd "$dir"
+separate(){
+    for k in $(seq 0 $((N - 1))); do $PARSER "mod$k.sd" > /dev/null || exit 1; done
+}
+full=$( { time separate; } 2>&1 )
+single=$( { time $PARSER all.sd > /dev/null; } 2>&1 )
+
+# change a function body in the middle, its interface is unchanged, rebuild one module
+m=$((N / 2))
+sed -i "s/s = s + i \* 1;/s = s + i * 2;/" "mod$m.sd"
+incremental=$( { time $PARSER "mod$m.sd" > /dev/null; } 2>&1 )
+
+printf "%-40s %8s\n" "build ($N modules, $FUNCS functions each)" "time(s)"
+printf "%-40s %8s\n" "single file" "$single"
+printf "%-40s %8s\n" "separate, full build" "$full"
+printf "%-40s %8s\n" "separate, rebuild one module" "$incremental"
+cd - > /dev/null
+rm -rf "$dir"
@@ -0,0 +1,36 @@
+# run time of the JVM (javaa + java), --run and the native -target=x86_64 build
+# usage (in p3): bash bench/native_bench.sh [sD files], default bench/*.sd
+JAVAA=${JAVAA:-../javaa/javaa}
+JAVA=${JAVA:-../jre1.8.0_451/bin/java}
+TIMEFORMAT=%R
+
+files=("$@")
+if [ ${#files[@]} -eq 0 ]; then
+    files=(bench/*.sd)
+fi
+jvm=1
+if [ ! -x "$JAVAA" ] || [ ! -x "$JAVA" ]; then
+    echo "JRE or javaa not found, the native output is compared with --run" >&2
+    jvm=0
+fi
+
+printf "%-20s %10s %10s %10s %8s\n" "program" "jvm(s)" "vm(s)" "native(s)" "output"
+for file in "${files[@]}"; do
+    name=$(basename "$file" .sd)
+
+    ./parser -target=x86_64 "$file" > /dev/null && as "$name.s" -o "$name.o" && ld "$name.o" -o "$name.native"
+    vm=$( { time ./parser --run "$file" > "$name.vm.out" 2> /dev/null; } 2>&1 )
+    native=$( { time "./$name.native" > "$name.native.out"; } 2>&1 )
+
+    # the reference output is the JVM's when it is available
+    reference="$name.vm.out"
+    t="-"
+    if [ $jvm -eq 1 ]; then
+        ./parser "$file" > /dev/null && $JAVAA "$name.jasm" > /dev/null 2>&1
+        t=$( { time $JAVA "$name" > "$name.jvm.out" 2> /dev/null; } 2>&1 )
+        reference="$name.jvm.out"
+    fi
+    if cmp -s "$reference" "$name.native.out" && cmp -s "$reference" "$name.vm.out"; then same="same"; else same="DIFF"; fi
+    printf "%-20s %10s %10s %10s %8s\n" "$name" "$t" "$vm" "$native" "$same"
+    rm -f "$name.jasm" "$name.class" "$name.s" "$name.o" "$name.native" "$name.jvm.out" "$name.vm.out" "$name.native.out" "$name.sdi"
+done
@@ -0,0 +1,26 @@
+# run time of a parallel foreach on the JVM, sequential build vs 1..nproc workers of the common pool
+# usage (in p3): bash bench/parallel_bench.sh [limit], default 5000000
+JAVAA=${JAVAA:-../javaa/javaa}
+JAVA=${JAVA:-../jre1.8.0_451/bin/java}
+TIMEFORMAT=%R
+limit=${1:-5000000}
+if [ ! -x "$JAVAA" ] || [ ! -x "$JAVA" ]; then
+    echo "JRE or javaa not found, the parallel foreach runs only on the JVM" >&2
+    exit 1
+fi
+
+sed "s/int limit = [0-9]*;/int limit = $limit;/" bench/parallel.sd > parallel.sd
+sed "s/parallel foreach/foreach/" parallel.sd > sequential.sd
+./parser parallel.sd > /dev/null && $JAVAA parallel.jasm > /dev/null 2>&1
+./parser sequential.sd > /dev/null && $JAVAA sequential.jasm > /dev/null 2>&1
+
+base=$( { time $JAVA sequential > sequential.out; } 2>&1 )
+printf "%-12s %10s %8s %8s\n" "workers" "time(s)" "speedup" "output"
+printf "%-12s %10s %8s %8s\n" "sequential" "$base" "1.00x" "-"
+for ((n = 1; n <= $(nproc); n *= 2)); do
+    t=$( { time $JAVA -Djava.util.concurrent.ForkJoinPool.common.parallelism=$n parallel > parallel.out; } 2>&1 )
+    if cmp -s sequential.out parallel.out; then same="same"; else same="DIFF"; fi
+    speedup=$(awk -v a="$base" -v b="$t" 'BEGIN { printf "%.2fx", a / b }')
+    printf "%-12s %10s %8s %8s\n" "$n" "$t" "$speedup" "$same"
+done
+rm -f parallel.sd sequential.sd parallel.jasm sequential.jasm parallel.class sequential.class parallel.out sequential.out
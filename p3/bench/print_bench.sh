@@ -0,0 +1,39 @@
+# output throughput of printing lines: System.out vs -fbuffered-output on the JVM, and --run
+# usage (in p3): bash bench/print_bench.sh [number of lines], default 10000000
+N=${1:-10000000}
+JAVAA=${JAVAA:-$(pwd)/../javaa/javaa}
+JAVA=${JAVA:-$(pwd)/../jre1.8.0_451/bin/java}
+PARSER=$(pwd)/parser
+TIMEFORMAT=%R
+dir=$(mktemp -d)
+cd "$dir"
+
+# every line is a run of constant prints and an int
+cat > lines.sd <<SD
+void main(){
+    int i;
+    for(i = 0; i < $N; i = i + 1){
+        print "line";
+        print " ";
+        println i;
+    }
+}
+SD
+sed "s/lines/buffered/" lines.sd > buffered.sd
+$PARSER lines.sd > /dev/null && $JAVAA lines.jasm > /dev/null 2>&1
+$PARSER -fbuffered-output buffered.sd > /dev/null && $JAVAA buffered.jasm > /dev/null 2>&1
+
+run(){
+    t=$( { time "$@" > out.txt 2> /dev/null; } 2>&1 )
+    lines=$(wc -l < out.txt)
+    rate=$(awk -v n="$lines" -v t="$t" 'BEGIN { if(t > 0) printf "%.1f", n / t / 1e6; else print "-" }')
+    printf "%-28s %10s %10s %12s\n" "$label" "$t" "$lines" "$rate"
+}
+printf "%-28s %10s %10s %12s\n" "mode ($N lines)" "time(s)" "lines" "Mlines/s"
+label="jvm System.out"; run $JAVA lines
+label="jvm -fbuffered-output"; run $JAVA buffered
+label="--run"; run $PARSER --run lines.sd
+label="--run -fbuffered-output"; run $PARSER -fbuffered-output --run lines.sd
+
+cd - > /dev/null
+rm -rf "$dir"
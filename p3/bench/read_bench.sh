@@ -0,0 +1,40 @@
+# time of reading integers from stdin: buffered reader vs -fnaive-read (java.util.Scanner) on the JVM, --run and x86_64
+# usage (in p3): bash bench/read_bench.sh [number of ints], default 10000000
+N=${1:-10000000}
+JAVAA=${JAVAA:-$(pwd)/../javaa/javaa}
+JAVA=${JAVA:-$(pwd)/../jre1.8.0_451/bin/java}
+PARSER=$(pwd)/parser
+TIMEFORMAT=%R
+dir=$(mktemp -d)
+cd "$dir"
+
+cat > readsum.sd <<'SD'
+void main(){
+    int n, i, x, total = 0;
+    read n;
+    for(i = 0; i < n; i = i + 1){
+        read x;
+        total = total + x;
+    }
+    println total;
+}
+SD
+sed "s/readsum/naivesum/" readsum.sd > naivesum.sd
+awk -v n="$N" 'BEGIN { srand(1); print n; for(i = 0; i < n; i++) print int(rand() * 2000001) - 1000000 }' > input.txt
+
+$PARSER readsum.sd > /dev/null && $JAVAA readsum.jasm > /dev/null 2>&1
+$PARSER -fnaive-read naivesum.sd > /dev/null && $JAVAA naivesum.jasm > /dev/null 2>&1
+$PARSER -target=x86_64 readsum.sd > /dev/null && as readsum.s -o readsum.o && ld readsum.o -o readsum.native
+
+run(){
+    t=$( { time "$@" < input.txt > out.txt 2> /dev/null; } 2>&1 )
+    printf "%-24s %10s %14s\n" "$label" "$t" "$(cat out.txt)"
+}
+printf "%-24s %10s %14s\n" "reader ($N ints)" "time(s)" "sum"
+label="jvm -fnaive-read"; run $JAVA naivesum
+label="jvm buffered"; run $JAVA readsum
+label="--run"; run $PARSER --run readsum.sd
+label="x86_64"; run ./readsum.native
+
+cd - > /dev/null
+rm -rf "$dir"
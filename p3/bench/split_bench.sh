@@ -0,0 +1,56 @@
+# a hot function over HugeMethodLimit (8000 bytes): unsplit (interpreted only) vs split into helpers (JIT-compiled)
+# usage (in p3): bash bench/split_bench.sh [iterations], default 200000
+N=${1:-200000}
+JAVAA=${JAVAA:-$(pwd)/../javaa/javaa}
+JAVA=${JAVA:-$(pwd)/../jre1.8.0_451/bin/java}
+PARSER=$(pwd)/parser
+TIMEFORMAT=%R
+dir=$(mktemp -d)
+cd "$dir"
+
+# the loop body of big is about 1200 statements
+{
+    echo "int big(int n){"
+    echo "    int a; int b; int c; int i;"
+    echo "    a = 1; b = 2; c = 3;"
+    echo "    for(i = 0; i < n; i = i + 1){"
+    for k in $(seq 1 400); do
+        echo "        a = (a * 7 + b + $k) % 1000003;"
+        echo "        b = (b + c * 3 - $k) % 1000003;"
+        echo "        c = (c * 5 + a) % 1000003;"
+    done
+    echo "    }"
+    echo "    return a + b + c;"
+    echo "}"
+    echo "void main(){"
+    echo "    println big($N);"
+    echo "}"
+} > unsplit.sd
+sed "s/unsplit/split/" unsplit.sd > split.sd
+jvm=1
+if [ ! -x "$JAVAA" ] || [ ! -x "$JAVA" ]; then
+    echo "JRE or javaa not found, only --run is measured" >&2
+    jvm=0
+fi
+$PARSER -fmethod-size-limit=0 unsplit.sd > /dev/null
+$PARSER split.sd 2>&1 > /dev/null | grep "^Warning: function" # sizes before and after the split
+if [ $jvm -eq 1 ]; then
+    $JAVAA unsplit.jasm > /dev/null 2>&1
+    $JAVAA split.jasm > /dev/null 2>&1
+fi
+
+run(){
+    t=$( { time "$@" > out.txt 2> /dev/null; } 2>&1 )
+    printf "%-40s %10s %14s\n" "$label" "$t" "$(cat out.txt)"
+}
+printf "%-40s %10s %14s\n" "mode ($N iterations)" "time(s)" "output"
+if [ $jvm -eq 1 ]; then
+    label="jvm unsplit"; run $JAVA unsplit
+    label="jvm split"; run $JAVA split
+    label="jvm unsplit -XX:-DontCompileHugeMethods"; run $JAVA -XX:-DontCompileHugeMethods unsplit
+fi
+label="--run unsplit"; run $PARSER -fmethod-size-limit=0 --run unsplit.sd
+label="--run split"; run $PARSER --run split.sd
+
+cd - > /dev/null
+rm -rf "$dir"
@@ -0,0 +1,100 @@
+# quality of the generated code: static metrics of every method (--stats), executed VM instructions,
+# output and JVM runtime of each kernel, compared against a stored baseline
+# usage (in p3): bash bench/suite_bench.sh [--update] [sD files], default bench/*.sd
+#   --update        write the results as the new baseline instead of comparing
+#   TOL=<percent>   allowed increase of the static metrics and executed instructions, default 0
+#   TIME_TOL=<pct>  allowed increase of the JVM runtime, default 20
+#   RUNS=<n>        JVM runs per kernel, the median is recorded, default 5
+#   BASELINE=<file> default bench/baseline.txt
+JAVAA=${JAVAA:-$(pwd)/../javaa/javaa}
+JAVA=${JAVA:-$(pwd)/../jre1.8.0_451/bin/java}
+PARSER=$(pwd)/parser
+BASELINE=${BASELINE:-$(pwd)/bench/baseline.txt}
+TOL=${TOL:-0}
+TIME_TOL=${TIME_TOL:-20}
+RUNS=${RUNS:-5}
+
+update=0
+if [ "$1" == "--update" ]; then
+    update=1
+    shift
+fi
+files=("$@")
+if [ ${#files[@]} -eq 0 ]; then
+    files=(bench/*.sd)
+fi
+jvm=1
+if [ ! -x "$JAVAA" ] || [ ! -x "$JAVA" ]; then
+    echo "JRE or javaa not found, runtime is not measured" >&2
+    jvm=0
+fi
+
+dir=$(mktemp -d)
+results="$dir/results.txt"
+for file in "${files[@]}"; do
+    name=$(basename "$file" .sd)
+    file=$(realpath "$file")
+    mkdir -p "$dir/$name"
+    cd "$dir/$name"
+
+    # kernel method metric value
+    $PARSER --stats "$file" 2>&1 > /dev/null | awk -v k="$name" '
+        $1 == "method" || $1 == "Warning:" { next }
+        NF == 6 { print k, $1, "insns", $2; print k, $1, "bytes", $3; print k, $1, "labels", $4;
+                  print k, $1, "max_stack", $5; print k, $1, "max_locals", $6 }' >> "$results"
+    executed=$($PARSER --run --count "$file" 2>&1 > run.out | awk '/executed instructions/ {print $3}')
+    echo "$name - vm_insns $executed" >> "$results"
+    echo "$name - output $(cksum < run.out | awk '{print $1}')" >> "$results"
+
+    if [ $jvm -eq 1 ] && $JAVAA "$name.jasm" > /dev/null 2>&1; then
+        for i in $(seq 1 $RUNS); do
+            start=$(date +%s%N)
+            $JAVA "$name" > /dev/null 2>&1
+            echo $(( ($(date +%s%N) - start) / 1000000 ))
+        done | sort -n | awk -v k="$name" '{ t[NR] = $1 } END { print k, "-", "jvm_ms", t[int((NR + 1) / 2)] }' >> "$results"
+    fi
+    cd - > /dev/null
+done
+
+if [ $update -eq 1 ]; then
+    { echo "# kernel method metric value, written by bench/suite_bench.sh --update"; cat "$results"; } > "$BASELINE"
+    echo "baseline written to $BASELINE ($(wc -l < "$results") values)"
+    rm -rf "$dir"
+    exit 0
+fi
+if [ ! -f "$BASELINE" ]; then
+    echo "no baseline $BASELINE, run bash bench/suite_bench.sh --update first" >&2
+    rm -rf "$dir"
+    exit 1
+fi
+
+# only the changed values are listed, the exit status is 1 if a value regressed beyond the tolerance
+# (the baseline runtime is of the machine that wrote it, and is skipped without a JRE)
+awk -v tol="$TOL" -v timeTol="$TIME_TOL" '
+    FNR == NR { if($1 !~ /^#/) base[$1 " " $2 " " $3] = $4; next }
+    {
+        key = $1 " " $2 " " $3
+        seen[key] = 1
+        kernel[$1] = 1
+        if($3 == "jvm_ms") timed = 1
+        if(!(key in base)){ printf "%-14s %-28s %-10s %12s %12s %9s %s\n", $1, $2, $3, "-", $4, "", "new"; next }
+        old = base[key]
+        if(old == $4) { same++; next }
+        if($3 == "output"){ printf "%-14s %-28s %-10s %12s %12s %9s %s\n", $1, $2, $3, old, $4, "", "REGRESSION"; bad++; next }
+        change = old == 0 ? 100 : ($4 - old) * 100.0 / old
+        limit = $3 == "jvm_ms" ? timeTol : tol
+        status = change > limit ? "REGRESSION" : (change < 0 ? "improved" : "within tolerance")
+        if(status == "REGRESSION") bad++
+        printf "%-14s %-28s %-10s %12s %12s %+8.1f%% %s\n", $1, $2, $3, old, $4, change, status
+    }
+    END {
+        for(key in base){
+            split(key, f, " ")
+            if(!(key in seen) && (f[1] in kernel) && (f[3] != "jvm_ms" || timed)){ printf "%-14s %-28s %-10s %12s %12s %9s %s\n", f[1], f[2], f[3], base[key], "-", "", "missing" }
+        }
+        printf "%d unchanged, %d regressions (tolerance %s%%, runtime %s%%)\n", same, bad, tol, timeTol
+        exit bad > 0
+    }' "$BASELINE" "$results"
+status=$?
+rm -rf "$dir"
+exit $status
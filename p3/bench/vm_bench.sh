@@ -0,0 +1,34 @@
+# end-to-end time of the JVM pipeline (parser + javaa + java) and --run
+# usage (in p3): bash bench/vm_bench.sh [sD files], default bench/*.sd
+JAVAA=${JAVAA:-../javaa/javaa}
+JAVA=${JAVA:-../jre1.8.0_451/bin/java}
+TIMEFORMAT=%R
+
+files=("$@")
+if [ ${#files[@]} -eq 0 ]; then
+    files=(bench/*.sd)
+fi
+jvm=1
+if [ ! -x "$JAVAA" ] || [ ! -x "$JAVA" ]; then
+    echo "JRE or javaa not found, only --run is measured" >&2
+    jvm=0
+fi
+
+jvm_pipeline(){
+    ./parser "$1" > /dev/null && $JAVAA "$2.jasm" > /dev/null && $JAVA "$2" > "$2.jvm.out"
+} 2> /dev/null
+
+printf "%-20s %10s %10s %8s\n" "program" "jvm(s)" "vm(s)" "output"
+for file in "${files[@]}"; do
+    name=$(basename "$file" .sd)
+
+    vm=$( { time ./parser --run "$file" > "$name.vm.out"; } 2>&1 )
+    if [ $jvm -eq 1 ]; then
+        t=$( { time jvm_pipeline "$file" "$name"; } 2>&1 )
+        if cmp -s "$name.jvm.out" "$name.vm.out"; then same="same"; else same="DIFF"; fi
+    else
+        t="-"; same="-"
+    fi
+    printf "%-20s %10s %10s %8s\n" "$name" "$t" "$vm" "$same"
+    rm -f "$name.jasm" "$name.class" "$name.jvm.out" "$name.vm.out"
+done
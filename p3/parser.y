@@ -5,7 +5,13 @@
 #include "SymbolTable.hpp"
 #include "AST.hpp"
 #include "CodeGenerator.hpp"
+#include "VM.hpp"
+#include "X86Backend.hpp"
+#ifdef SIMD_LEXER
+#include "SimdLexer.hpp"
+#else
 #include "lex.yy.cpp"
+#endif
 #include <string>
 #include <vector>
 #include <iostream> 
@@ -33,6 +39,11 @@ void exitScope();
 // code generator
 CodeGenerator* codegen = nullptr;
 
+// directories searched for the interface files of extern modules (-I)
+vector<string> includePaths;
+// option of a target that cannot link extern modules ("--run", "-target=x86_64"), empty for the JVM
+string noExternTarget = "";
+
 // yyerror
 void yyerror(string s);
 
@@ -73,7 +84,7 @@ bool printJasm = false;
 %token TRUE FALSE
 %token EXTERN CONST VOID_TYPE CHAR_TYPE STRING_TYPE BOOL_TYPE INT_TYPE FLOAT_TYPE DOUBLE_TYPE
 %token IF ELSE SWITCH CASE DEFAULT
-%token DO WHILE FOR FOREACH CONTINUE BREAK RETURN
+%token DO WHILE FOR FOREACH PARALLEL CONTINUE BREAK RETURN
 %token READ PRINT PRINTLN
 %token INC DEC LE GE EQ NEQ LOGICAL_AND LOGICAL_OR
 
@@ -113,6 +124,31 @@ decl:
     | constant_decl   { Trace("Reduce: <constant_decl> => <decl>"); }
     | variable_decl   { Trace("Reduce: <variable_decl> => <decl>"); }
     | function_decl   { Trace("Reduce: <function_decl> => <decl>"); }
+    | extern_decl     { Trace("Reduce: <extern_decl> => <decl>"); }
+;
+
+
+/*
+ * extern_decl:
+ * import the exported globals of a separately compiled module from its interface file <module>.sdi,
+ * identifiers not declared in this file are looked up in the imported modules
+ */
+extern_decl:
+    EXTERN ID ';' {
+        Trace("Reduce: <EXTERN> <ID> <';'> => <extern_decl>");
+        if(noExternTarget != "") yyerror(string("extern ") + $2 + ", modules are only linked on the JVM target, not with " + noExternTarget);
+        for(ModuleInterface* module : sbt->modules){
+            if(module->module == $2) yyerror(string("module ") + $2 + " is imported twice");
+        }
+        ModuleInterface* module = new ModuleInterface();
+        bool success = false;
+        for(string& dir : includePaths){
+            if(module->open(dir + "/" + $2 + ".sdi", $2)){ success = true; break; }
+            if(module->error.rfind("cannot open", 0) != 0) break; // found but broken
+        }
+        if(!success) yyerror(string("extern ") + $2 + ", " + module->error);
+        sbt->modules.push_back(module);
+    }
 ;
 
 
@@ -436,10 +472,15 @@ simple_stmt:
                                             if(entry->isArray) yyerror("identifier " + entry->name + " is array");
                                             if(entry->isFunc) yyerror("identifier " + entry->name + " is function");
                                             if(entry->isConst) yyerror("identifier " + entry->name + " is constant variable");
+                                            if(!(entry->dataType == DataType::INT_T || entry->dataType == DataType::BOOL_T)){
+                                                yyerror(getTypeStr(entry->dataType) + " type cannot read");
+                                            }
                                             $$ = makeNode(); $$->dataType = DataType::UNKNOWN; 
+                                            codegen->generateRead(entry);
                                         } 
     | READ array_reference ';'          { 
                                             Trace("Reduce: <READ> <array_reference> <';'> => <simple_stmt>"); 
+                                            yyerror("array element cannot read, arrays have no code generation");
                                             $$ = makeNode(); $$->dataType = DataType::UNKNOWN; 
                                         }                                                    
 ;
@@ -508,10 +549,15 @@ simple_stmt_without_semicolon:
                                             if(entry->isArray) yyerror("identifier " + entry->name + " is array");
                                             if(entry->isFunc) yyerror("identifier " + entry->name + " is function");
                                             if(entry->isConst) yyerror("identifier " + entry->name + " is constant variable");
+                                            if(!(entry->dataType == DataType::INT_T || entry->dataType == DataType::BOOL_T)){
+                                                yyerror(getTypeStr(entry->dataType) + " type cannot read");
+                                            }
                                             $$ = makeNode(); $$->dataType = DataType::UNKNOWN; 
+                                            codegen->generateRead(entry);
                                         } 
     | READ array_reference              { 
                                             Trace("Reduce: <READ> <array_reference> => <simple_stmt_without_semicolon>"); 
+                                            yyerror("array element cannot read, arrays have no code generation");
                                             $$ = makeNode(); $$->dataType = DataType::UNKNOWN; 
                                         }                                                        
 ;
@@ -568,6 +614,21 @@ loop_stmt:
         node->children = {entry, $5, $7};
         codegen->generateForeach(node);
     }
+    | PARALLEL FOREACH '(' ID ':' numeric RANGE_OP numeric ')' enter_scope scoped_stmt exit_scope {
+        Trace("Reduce: <PARALLEL> <FOREACH> <'('> <ID> <':'> <numeric> <RANGE_OP> <numeric> <)> <simple_or_block_stmt> => <loop_stmt>");
+        AstNode* entry = sbt->lookup($4);
+        if(entry == nullptr) yyerror(string("ID ") + $4 + " is not declared");
+        if(entry->isArray) yyerror("identifier " + entry->name + " is array");
+        if(entry->isFunc) yyerror("identifier " + entry->name + " is function");
+        if(entry->isGlobal || entry->isConst) yyerror("loop variable of parallel foreach must be a local variable");
+        $$ = makeNode($11); // return type of statement
+        if($$->dataType != DataType::UNKNOWN) yyerror("parallel foreach: return inside the loop");
+        AstNode* node = makeNode();
+        entry->exprType = ExprType::EXPR_ID;
+        node->children = {entry, $6, $8};
+        string reason = codegen->generateParallelForeach(node);
+        if(reason != "") yyerror("parallel foreach: " + reason);
+    }
 ;
 
 /* numeric: number use in foreach statement, must be integer ID or integer constant val*/
@@ -584,6 +645,7 @@ numeric:
             $$->name = entry->name;
             $$->number = entry->number;
             $$->isGlobal = entry->isGlobal;
+            $$->module = entry->module;
      }     
     | INT_VAL  { Trace("Reduce: <INT_VAL: " + to_string($1) + "> => <numeric>"); $$ = makeNode(); $$->dataType = DataType::INT_T; $$->isConst = true; $$->iVal = $1; $$->exprType = ExprType::EXPR_LITERAL; }
     | '-' INT_VAL  { Trace("Reduce: <INT_VAL: " + to_string($2) + "> => <numeric>"); $$ = makeNode(); $$->dataType = DataType::INT_T; $$->isConst = true; $$->iVal = -$2; $$->exprType = ExprType::EXPR_LITERAL; }
@@ -781,8 +843,9 @@ expr:
                                         if(!($1->dataType == DataType::INT_T || $1->dataType == DataType::FLOAT_T)){
                                             yyerror(getTypeStr($1->dataType) + " type cannot div");
                                         }
+                                        if($1->isConst && $3->isConst && $3->iVal == 0) yyerror("division by zero");
                                         $$ = makeNode(); 
-                                        $$->iVal = $1->iVal / $3->iVal;
+                                        if($3->iVal != 0) $$->iVal = $1->iVal / $3->iVal; // iVal of a non-constant operand is 0
                                         $$->dataType = $1->dataType;
                                         $$->isConst = $1->isConst && $3->isConst;
                                         $$->exprType = ExprType::EXPR_DIV;
@@ -796,8 +859,9 @@ expr:
                                         if(!($1->dataType == DataType::INT_T)){
                                             yyerror(getTypeStr($1->dataType) + " type cannot mod");
                                         }
+                                        if($1->isConst && $3->isConst && $3->iVal == 0) yyerror("modulo by zero");
                                         $$ = makeNode(); 
-                                        $$->iVal = $1->iVal % $3->iVal;
+                                        if($3->iVal != 0) $$->iVal = $1->iVal % $3->iVal; // iVal of a non-constant operand is 0
                                         $$->dataType = DataType::INT_T;
                                         $$->isConst = $1->isConst && $3->isConst;
                                         $$->exprType = ExprType::EXPR_MOD;
@@ -818,7 +882,8 @@ expr:
                                         $$->exprType = ExprType::EXPR_INC_POSTFIX;
                                         $$->name = entry->name;    
                                         $$->number = entry->number;       
-                                        $$->isGlobal = entry->isGlobal; 
+                                        $$->isGlobal = entry->isGlobal;
+                                        $$->module = entry->module; 
                                   }
     | ID DEC  %prec POSTFIX_DEC   {
                                         Trace("Reduce: <expr> <DEC> => <expr>"); 
@@ -835,7 +900,8 @@ expr:
                                         $$->exprType = ExprType::EXPR_DEC_POSTFIX;
                                         $$->name = entry->name;    
                                         $$->number = entry->number;   
-                                        $$->isGlobal = entry->isGlobal;    
+                                        $$->isGlobal = entry->isGlobal;
+                                        $$->module = entry->module;    
                                   }
     | INC ID  %prec PREFIX_INC    {
                                         Trace("Reduce: <INC> <expr> => <expr>"); 
@@ -852,7 +918,8 @@ expr:
                                         $$->exprType = ExprType::EXPR_INC_PREFIX;
                                         $$->name = entry->name;    
                                         $$->number = entry->number;       
-                                        $$->isGlobal = entry->isGlobal;     
+                                        $$->isGlobal = entry->isGlobal;
+                                        $$->module = entry->module;     
                                     }
     | DEC ID  %prec PREFIX_DEC    {
                                         Trace("Reduce: <DEC> <expr> => <expr>"); 
@@ -869,7 +936,8 @@ expr:
                                         $$->exprType = ExprType::EXPR_DEC_PREFIX;
                                         $$->name = entry->name;    
                                         $$->number = entry->number;   
-                                        $$->isGlobal = entry->isGlobal;       
+                                        $$->isGlobal = entry->isGlobal;
+                                        $$->module = entry->module;       
                                     } 
     | '+' expr  %prec UPLUS         {
                                         Trace("Reduce: <'+'> <expr> => <expr>"); 
@@ -922,6 +990,7 @@ expr:
                                         $$ = makeNode();
                                         $$->dataType = fn->dataType;
                                         $$->name = fn->name;
+                                        $$->module = fn->module;
                                         $$->children = *argList;
                                         $$->exprType = ExprType::EXPR_FUNCCALL;
                                     }
@@ -942,6 +1011,7 @@ expr:
                                         $$->exprType = ExprType::EXPR_ID;
                                         $$->number = entry->number;
                                         $$->isGlobal = entry->isGlobal;
+                                        $$->module = entry->module;
                                     } 
     | literal                       { Trace("Reduce: <literal> => <expr>"); $$ = $1; $$->exprType = ExprType::EXPR_LITERAL; }
 ;
@@ -967,8 +1037,8 @@ array_reference:
         $$ = makeNode();
         $$->dataType = entry->dataType;
         // array slicing, when not giving full dimension
-        if(entry->arrayDims.size() != numDims){
-            for(int i=numDims; i<entry->arrayDims.size(); i++){
+        if((int)entry->arrayDims.size() != numDims){
+            for(int i=numDims; i<(int)entry->arrayDims.size(); i++){
                 $$->arrayDims.push_back(entry->arrayDims[i]);
             }
             $$->isArray = true;
@@ -1062,6 +1132,20 @@ void exitScope(){
 }
 
 
+#ifdef SIMD_LEXER
+// hand-written lexer, replace the flex scanner when built with LEXER=simd
+FILE* yyin = nullptr;
+int linenum = 1;
+int yylex(){
+    static SimdLexer* lexer = nullptr;
+    if(lexer == nullptr) lexer = new SimdLexer(yyin);
+    int token = lexer->next(&yylval);
+    linenum = lexer->line();
+    return token;
+}
+#endif
+
+
 // yyerror, print error message
 void yyerror(string s) {
     cout << "Error: " << s << ", in line " << linenum << endl;
@@ -1081,14 +1165,62 @@ string getClassName(string path){
     return path.substr(begin, len);
 }
 
+// print options and exit
+void usage(){
+    printf("Usage: ./parser [options] <sD filename>\n");
+    printf("  -fprofile-generate        count executions, the program writes <class>.prof on exit (JVM target only)\n");
+    printf("  -fprofile-use[=<file>]    use the profile (default <class>.prof) to lay out code\n");
+    printf("  --run                     execute the program in the built-in VM instead of writing jasm\n");
+    printf("  --count                   with --run, print the number of executed VM instructions to stderr\n");
+    printf("  --stats                   print instructions, bytes, labels, max_stack and max_locals of every method to stderr\n");
+    printf("  -fcse                     eliminate common subexpressions inside each expression\n");
+    printf("  -fpromote-globals         keep globals in local slots inside loops\n");
+    printf("  -fmethod-size-limit=<n>   split methods over n bytes of bytecode into helpers (default 8000, 0: off)\n");
+    printf("  -fbuffered-output         merge prints of constants and print through one buffered PrintWriter\n");
+    printf("  -fnaive-read              lower read to a shared java.util.Scanner instead of the buffered reader\n");
+    printf("  -target=x86_64            write native assembly <class>.s instead of jasm\n");
+    printf("  -I <dir>                  search <dir> for the interface files (.sdi) of extern modules (JVM target only)\n");
+    exit(1);
+}
+
 // main function
 int main(int argc, char* argv[]) {
-    if(argc != 2) {
-        printf("Usage: ./parser <sD filename>\n");
+    string path = "";
+    bool profileGenerate = false, profileUse = false, runVM = false, native = false, countInsns = false, stats = false, cse = false, promote = false, naiveRead = false, buffered = false;
+    int methodSizeLimit = 8000;
+    string profilePath = "";
+    for(int i=1; i<argc; i++){
+        string arg = argv[i];
+        if(arg == "--run") runVM = true;
+        else if(arg == "--count") countInsns = true;
+        else if(arg == "--stats") stats = true;
+        else if(arg == "-fcse") cse = true;
+        else if(arg == "-fpromote-globals") promote = true;
+        else if(arg == "-fnaive-read") naiveRead = true;
+        else if(arg == "-fbuffered-output") buffered = true;
+        else if(arg.rfind("-fmethod-size-limit=", 0) == 0) methodSizeLimit = atoi(arg.c_str() + 20);
+        else if(arg == "-target=x86_64") native = true;
+        else if(arg == "-I" && i + 1 < argc) includePaths.push_back(argv[++i]);
+        else if(arg.rfind("-I", 0) == 0 && arg.size() > 2) includePaths.push_back(arg.substr(2));
+        else if(arg.rfind("-target=", 0) == 0 && arg != "-target=jvm") usage();
+        else if(arg == "-fprofile-generate") profileGenerate = true;
+        else if(arg == "-fprofile-use") profileUse = true;
+        else if(arg.rfind("-fprofile-use=", 0) == 0){ profileUse = true; profilePath = arg.substr(14); }
+        else if(arg[0] == '-') usage();
+        else if(path == "") path = arg;
+        else usage();
+    }
+    if(path == "") usage();
+    includePaths.push_back(".");
+    if(runVM) noExternTarget = "--run";
+    else if(native) noExternTarget = "-target=x86_64";
+    if(profileGenerate && (runVM || native)){
+        cout << "Error: -fprofile-generate is not supported with " << (runVM ? "--run" : "-target=x86_64")
+             << ", the profile is written by a JVM shutdown hook" << endl;
         exit(1);
     }
 
-    yyin = fopen(argv[1], "r"); 
+    yyin = fopen(path.c_str(), "r"); 
     if(!yyin){
         perror("fopen"); 
         exit(1);
@@ -1096,22 +1228,72 @@ int main(int argc, char* argv[]) {
 
     // start parsing
     sbt = new SymbolTable(true);
-    string className = getClassName(argv[1]);
+    string className = getClassName(path);
     codegen = new CodeGenerator(className);
+    codegen->setProfileGenerate(profileGenerate);
+    codegen->setCse(cse);
+    codegen->setPromoteGlobals(promote);
+    codegen->setParallel(!runVM && !native); // the VM and x86_64 targets run parallel foreach sequentially
+    codegen->setReadHelpers(!runVM && !native);
+    codegen->setNaiveRead(naiveRead);
+    codegen->setMethodSizeLimit(methodSizeLimit);
+    codegen->setBufferedOutput(buffered, buffered && !runVM && !native); // the VM and x86_64 runtimes buffer stdout already
+    if(profileUse){
+        if(profilePath == "") profilePath = className + ".prof";
+        if(!codegen->loadProfile(profilePath)){
+            perror(profilePath.c_str());
+            exit(1);
+        }
+    }
     yyparse();
 
-    // check main() 
+    // check main(), a JVM class without main can still be imported by extern
     AstNode* mainFunc = sbt->lookup("main");
-    if(mainFunc == nullptr) yyerror("no main function");
-    if(!mainFunc->isFunc) yyerror("main is not a function");
-    if(mainFunc->dataType != DataType::VOID_T) yyerror("return type of main() is not void");
+    if(mainFunc == nullptr){
+        if(runVM || native) yyerror("no main function");
+        cerr << "Warning: no main function, " << className << " can only be used as an extern module" << endl;
+    }
+    else{
+        if(!mainFunc->isFunc) yyerror("main is not a function");
+        if(mainFunc->dataType != DataType::VOID_T) yyerror("return type of main() is not void");
+    }
 
     if(printSbt){
         cout << endl << "global Symbol Table: ";
         sbt->dump();
     }
 
+    if(profileUse) codegen->reportProfile(10);
+    if(stats) codegen->reportStats();
+    if(runVM){
+        VM vm;
+        if(!vm.load(codegen->getJasm())){
+            cout << "Error: --run, " << vm.error << endl;
+            exit(1);
+        }
+        int status = vm.run(countInsns);
+        if(countInsns) fprintf(stderr, "executed instructions: %lld\n", vm.executed);
+        delete sbt;
+        delete codegen;
+        return status;
+    }
+    if(native){
+        X86Backend backend;
+        if(!backend.generate(codegen->getJasm())){
+            cout << "Error: -target=x86_64, " << backend.error << endl;
+            exit(1);
+        }
+        backend.dump();
+        delete sbt;
+        delete codegen;
+        return 0;
+    }
+
     string jasm = codegen->dump();
+    if(!ModuleInterface::write(className + ".sdi", sbt)){
+        perror((className + ".sdi").c_str());
+        exit(1);
+    }
     if(printJasm){
         cout << jasm << endl;
     }
@@ -0,0 +1,41 @@
+# compile, assemble and run the programs of test/ that have a .expected stdout, compare stdout (and <name>.prof)
+# flags come from a "// flags: ..." first line, stdin from <name>.in
+# without a JRE the programs run with --run, programs of JVM-only flags (-fprofile-generate) are skipped
+# usage (in p3): bash test/check.sh
+JAVAA=${JAVAA:-$(pwd)/../javaa/javaa}
+JAVA=${JAVA:-$(pwd)/../jre1.8.0_451/bin/java}
+PARSER=$(pwd)/parser
+TEST=$(pwd)/test
+jvm=1
+if [ ! -x "$JAVA" ] || [ ! -x "$JAVAA" ]; then
+    echo "no JRE or javaa ($JAVA, $JAVAA), checking with --run"
+    jvm=0
+fi
+dir=$(mktemp -d)
+cd "$dir"
+
+failed=0
+for expected in "$TEST"/*.expected; do
+    name=$(basename "$expected" .expected)
+    flags=$(sed -n '1s|^// flags: ||p' "$TEST/$name.sd")
+    input="$TEST/$name.in"
+    [ -f "$input" ] || input=/dev/null
+    if [ $jvm = 1 ]; then
+        $PARSER $flags "$TEST/$name.sd" > /dev/null && $JAVAA "$name.jasm" > /dev/null || { echo "FAIL $name: compile"; failed=1; continue; }
+        $JAVA "$name" < "$input" > "$name.out" 2> "$name.err"
+    else
+        case " $flags " in *" -fprofile-generate "*) echo "skip $name: $flags needs the JVM"; continue;; esac
+        $PARSER --run $flags "$TEST/$name.sd" < "$input" > "$name.out" 2> "$name.err"
+    fi
+    if ! cmp -s "$name.out" "$expected"; then
+        echo "FAIL $name: stdout"; diff "$expected" "$name.out" | head -5; failed=1; continue
+    fi
+    if [ -f "$TEST/$name.prof" ] && ! cmp -s "$name.prof" "$TEST/$name.prof"; then
+        echo "FAIL $name: profile"; diff "$TEST/$name.prof" "$name.prof" | head -5; failed=1; continue
+    fi
+    echo "ok   $name"
+done
+
+cd - > /dev/null
+rm -rf "$dir"
+exit $failed